@@ -0,0 +1,198 @@
+#pragma once
+
+#include <Rabotnik/Exception.h>
+
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#include <boost/utility.hpp>
+
+#include <cstddef>
+#include <limits>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Bump-pointer allocator over a fixed range of memory.
+   *
+   * Memory is freed only all at once, with reset().
+   */
+  class Arena : boost::noncopyable
+  {
+    char * m_begin;
+    char * m_current;
+    char * m_end;
+
+    public:
+      Arena(char * begin, size_t size)
+        : m_begin(begin),
+          m_current(begin),
+          m_end(begin + size)
+      {
+      }
+
+      /**
+       * @brief Throws Exception when the arena is full.
+       *
+       * @param alignment Power of two.
+       */
+      void * allocate(size_t size, size_t alignment)
+      {
+        char * p = reinterpret_cast<char*>(
+            (reinterpret_cast<size_t>(m_current) + alignment - 1)
+              & ~(alignment - 1));
+        if (p > m_end || size > size_t(m_end - p))
+        {
+          throw Exception("Overflow in void * Arena::allocate().");
+        }
+        m_current = p + size;
+        return p;
+      }
+
+      /**
+       * @brief Frees all allocated memory. Does not call destructors.
+       */
+      void reset()
+      {
+        m_current = m_begin;
+      }
+
+      size_t getSize() const
+      {
+        return m_end - m_begin;
+      }
+
+      size_t getNumBytesUsed() const
+      {
+        return m_current - m_begin;
+      }
+  };
+
+  namespace Internal
+  {
+    /**
+     * @brief Base class of StaticArena, so that the storage is constructed
+     * before the arena pointing into it.
+     */
+    template<size_t _Size>
+    class StaticArenaStorage
+    {
+      protected:
+        typename boost::aligned_storage<_Size>::type m_storage;
+    };
+  }
+
+  /**
+   * @brief Arena with its memory stored inline.
+   *
+   * @param _Size Size of the arena in bytes.
+   */
+  template<size_t _Size>
+  class StaticArena
+    : private Internal::StaticArenaStorage<_Size>,
+      public Arena
+  {
+    public:
+      StaticArena()
+        : Arena(static_cast<char*>(this->m_storage.address()), _Size)
+      {
+      }
+  };
+
+  /**
+   * @brief Standard allocator allocating from an Arena.
+   *
+   * deallocate() does nothing; the memory is freed when the arena is reset or
+   * destroyed. Has no default constructor, so containers using it must be
+   * given an allocator, eg.
+   * std::vector<int, ArenaAllocator<int> > v(ArenaAllocator<int>(arena)).
+   */
+  template<typename _T>
+  class ArenaAllocator
+  {
+    template<typename _U> friend class ArenaAllocator;
+
+    Arena * m_arena;
+
+    public:
+      typedef _T value_type;
+      typedef _T * pointer;
+      typedef const _T * const_pointer;
+      typedef _T & reference;
+      typedef const _T & const_reference;
+      typedef size_t size_type;
+      typedef ptrdiff_t difference_type;
+
+      template<typename _U>
+      struct rebind
+      {
+        typedef ArenaAllocator<_U> other;
+      };
+
+      explicit ArenaAllocator(Arena & arena)
+        : m_arena(&arena)
+      {
+      }
+
+      template<typename _U>
+      ArenaAllocator(const ArenaAllocator<_U> & other)
+        : m_arena(other.m_arena)
+      {
+      }
+
+      Arena & getArena() const
+      {
+        return *m_arena;
+      }
+
+      pointer address(reference x) const
+      {
+        return &x;
+      }
+
+      const_pointer address(const_reference x) const
+      {
+        return &x;
+      }
+
+      pointer allocate(size_type n, const void * = 0)
+      {
+        if (n > max_size())
+        {
+          throw Exception("Overflow in ArenaAllocator::allocate().");
+        }
+        return static_cast<pointer>(m_arena->allocate(
+              n * sizeof(_T), boost::alignment_of<_T>::value));
+      }
+
+      void deallocate(pointer, size_type)
+      {
+      }
+
+      size_type max_size() const
+      {
+        return std::numeric_limits<size_type>::max() / sizeof(_T);
+      }
+
+      void construct(pointer p, const _T & value)
+      {
+        new (p) _T(value);
+      }
+
+      void destroy(pointer p)
+      {
+        p->~_T();
+      }
+
+      template<typename _U>
+      bool operator==(const ArenaAllocator<_U> & other) const
+      {
+        return m_arena == other.m_arena;
+      }
+
+      template<typename _U>
+      bool operator!=(const ArenaAllocator<_U> & other) const
+      {
+        return m_arena != other.m_arena;
+      }
+  };
+}
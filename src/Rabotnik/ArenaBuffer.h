@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Rabotnik/Arena.h>
+
+namespace Rabotnik
+{
+  namespace Internal
+  {
+    /**
+     * @brief Base class of ArenaBuffer, so that the arena is constructed
+     * before and destroyed after the buffer.
+     */
+    template<size_t _ArenaSize>
+    class ArenaHolder
+    {
+      protected:
+        StaticArena<_ArenaSize> m_arena;
+    };
+  }
+
+  /**
+   * @brief Buffer carrying an arena for the variable-size payloads of its
+   * items, eg. strings and vectors using ArenaAllocator.
+   *
+   * Use as the buffer type of a buffer queue, eg.
+   * PushBufferQueue<ArenaBuffer<StaticQueue<Item, 100>, 65536>, 3>. The
+   * producer allocates from getArena(). When the queue recycles the buffer,
+   * the items are destroyed without freeing anything, and the arena starts
+   * empty again, so no memory is freed across threads. The handler's
+   * processBuffer() must take ArenaBuffer.
+   *
+   * @param _Buffer Type of the buffer object. Must be a class.
+   * @param _ArenaSize Size of the arena in bytes.
+   */
+  template<typename _Buffer, size_t _ArenaSize>
+  class ArenaBuffer
+    : private Internal::ArenaHolder<_ArenaSize>,
+      public _Buffer
+  {
+    public:
+      Arena & getArena()
+      {
+        return this->m_arena;
+      }
+
+      const Arena & getArena() const
+      {
+        return this->m_arena;
+      }
+
+      template<typename _T>
+      ArenaAllocator<_T> getAllocator()
+      {
+        return ArenaAllocator<_T>(this->m_arena);
+      }
+
+      /**
+       * @brief Clears the buffer and frees the arena, for reusing the buffer
+       * outside a buffer queue. Requires _Buffer::clear().
+       */
+      void reset()
+      {
+        _Buffer::clear();
+        this->m_arena.reset();
+      }
+  };
+}
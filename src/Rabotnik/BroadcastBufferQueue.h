@@ -0,0 +1,394 @@
+#pragma once
+
+#include <Rabotnik/Exception.h>
+#include <Rabotnik/Internal/CacheLine.h>
+#include <Rabotnik/Internal/Utilities.h>
+#include <Rabotnik/Trace.h>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/utility.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/type_traits/type_with_alignment.hpp>
+
+#include <utility>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Static-sized, multithreaded, single-producer / multi-consumer
+   * buffer ring, where every reader sees every buffer.
+   *
+   * The producer publishes each buffer once, and each registered reader
+   * advances its own sequence cursor. A buffer is reused only after all
+   * readers have finished reading it. A reader may depend on other readers,
+   * in which case it sees a buffer only after its dependencies have finished
+   * reading it.
+   *
+   * The producer looks at the reader cursors only when the ring seems full,
+   * so publishing a buffer costs the same regardless of the number of
+   * readers.
+   *
+   * Readers must be added before the first buffer is written. Use
+   * BroadcastBufferQueueReader as the buffer queue of a ReaderThread to read
+   * from the ring.
+   *
+   * @param _Buffer Type of the buffer object.
+   * @param _BufferCount Number of buffers.
+   * @param _MaxReaders Maximum number of readers.
+   */
+  template<typename _Buffer, unsigned int _BufferCount, unsigned int _MaxReaders>
+  class BroadcastBufferQueue : boost::noncopyable
+  {
+    typedef boost::uint64_t sequence;
+
+    struct ReaderSlot
+    {
+      /**
+       * @brief Number of buffers the reader has finished reading.
+       */
+      Internal::CacheLinePadded<boost::atomic<sequence> > cursor;
+      /**
+       * @brief Number of buffers known to be available to the reader. Only
+       * accessed by the reader.
+       */
+      sequence cachedAvailable;
+      unsigned int numDependencies;
+      unsigned int dependencies[_MaxReaders];
+      char padding[RABOTNIK_CACHE_LINE_SIZE];
+    };
+
+    /**
+     * @brief Storage of the buffers, aligned for _Buffer.
+     */
+    union
+    {
+      char m_buffers[_BufferCount * sizeof(_Buffer)];
+      typename boost::type_with_alignment<
+        boost::alignment_of<_Buffer>::value>::type m_alignment;
+    };
+
+    /**
+     * @brief Number of buffers published by the producer.
+     */
+    Internal::CacheLinePadded<boost::atomic<sequence> > m_published;
+
+    /**
+     * @brief Lowest reader cursor seen by the producer. Only accessed by the
+     * producer.
+     */
+    sequence m_cachedMinCursor;
+    /**
+     * @brief Whether a buffer was begun but not finished. Only accessed by
+     * the producer.
+     */
+    bool m_isWriting;
+
+    ReaderSlot m_readers[_MaxReaders];
+    unsigned int m_numReaders;
+
+    boost::atomic<unsigned int> m_numWaiters;
+    boost::mutex m_waitMutex;
+    boost::condition_variable m_waitCond;
+
+    _Buffer * getBuffer(sequence s)
+    {
+      return reinterpret_cast<_Buffer*>(
+          &m_buffers[(s % _BufferCount) * sizeof(_Buffer)]);
+    }
+
+    sequence getMinCursor() const
+    {
+      sequence min = m_published.value.load(boost::memory_order_relaxed);
+      for (unsigned int i = 0; i < m_numReaders; ++i)
+      {
+        sequence cursor
+          = m_readers[i].cursor.value.load(boost::memory_order_acquire);
+        if (cursor < min)
+        {
+          min = cursor;
+        }
+      }
+      return min;
+    }
+
+    /**
+     * @brief Returns true if reader depends on other, directly or through
+     * other readers.
+     */
+    bool isDependent(unsigned int reader, unsigned int other) const
+    {
+      bool isVisited[_MaxReaders] = {};
+      unsigned int pending[_MaxReaders];
+      unsigned int numPending = 0;
+      pending[numPending++] = reader;
+      isVisited[reader] = true;
+      while (numPending)
+      {
+        const ReaderSlot & slot = m_readers[pending[--numPending]];
+        for (unsigned int i = 0; i < slot.numDependencies; ++i)
+        {
+          unsigned int dependency = slot.dependencies[i];
+          if (dependency == other)
+          {
+            return true;
+          }
+          if (!isVisited[dependency])
+          {
+            isVisited[dependency] = true;
+            pending[numPending++] = dependency;
+          }
+        }
+      }
+      return false;
+    }
+
+    sequence getAvailable(unsigned int reader) const
+    {
+      const ReaderSlot & slot = m_readers[reader];
+      sequence available
+        = m_published.value.load(boost::memory_order_acquire);
+      for (unsigned int i = 0; i < slot.numDependencies; ++i)
+      {
+        sequence cursor = m_readers[slot.dependencies[i]].cursor.value.load(
+            boost::memory_order_acquire);
+        if (cursor < available)
+        {
+          available = cursor;
+        }
+      }
+      return available;
+    }
+
+    /**
+     * @brief Wakes up waiting threads after a cursor has been stored.
+     *
+     * The cursor store and the load of m_numWaiters are both sequentially
+     * consistent, so either the waiter sees the new cursor or this sees the
+     * waiter.
+     */
+    void notifyWaiters()
+    {
+      if (m_numWaiters.load() != 0)
+      {
+        {
+          boost::unique_lock<boost::mutex> lock(m_waitMutex);
+        }
+        m_waitCond.notify_all();
+      }
+    }
+
+    public:
+      typedef _Buffer buffer;
+
+      BroadcastBufferQueue()
+        : m_cachedMinCursor(0),
+          m_isWriting(false),
+          m_numReaders(0),
+          m_numWaiters(0)
+      {
+        m_published.value.store(0);
+      }
+
+      /**
+       * @brief Registers a new reader.
+       *
+       * @return Index of the reader.
+       */
+      unsigned int addReader()
+      {
+        if (m_numReaders == _MaxReaders)
+        {
+          throw Exception("Too many readers in BroadcastBufferQueue.");
+        }
+        ReaderSlot & slot = m_readers[m_numReaders];
+        slot.cursor.value.store(0);
+        slot.cachedAvailable = 0;
+        slot.numDependencies = 0;
+        return m_numReaders++;
+      }
+
+      /**
+       * @brief Makes reader see buffers only after dependsOn has finished
+       * reading them. Adding the same dependency again does nothing.
+       *
+       * Throws if dependsOn already depends on reader, since neither would
+       * ever see a buffer.
+       */
+      void addDependency(unsigned int reader, unsigned int dependsOn)
+      {
+        if (reader >= m_numReaders || dependsOn >= m_numReaders
+            || reader == dependsOn)
+        {
+          throw Exception("Invalid dependency in BroadcastBufferQueue.");
+        }
+        ReaderSlot & slot = m_readers[reader];
+        for (unsigned int i = 0; i < slot.numDependencies; ++i)
+        {
+          if (slot.dependencies[i] == dependsOn)
+          {
+            return;
+          }
+        }
+        if (isDependent(dependsOn, reader))
+        {
+          throw Exception("Cyclic dependency in BroadcastBufferQueue.");
+        }
+        if (slot.numDependencies == _MaxReaders)
+        {
+          throw Exception("Too many dependencies in BroadcastBufferQueue.");
+        }
+        slot.dependencies[slot.numDependencies++] = dependsOn;
+      }
+
+      unsigned int getNumReaders() const
+      {
+        return m_numReaders;
+      }
+
+      const _Buffer & beginReading(unsigned int reader)
+      {
+        ReaderSlot & slot = m_readers[reader];
+        sequence next = slot.cursor.value.load(boost::memory_order_relaxed);
+        if (next >= slot.cachedAvailable)
+        {
+          slot.cachedAvailable = getAvailable(reader);
+          if (next >= slot.cachedAvailable)
+          {
+            RABOTNIK_TRACE_SCOPE("BroadcastBufferQueue::park");
+            boost::unique_lock<boost::mutex> lock(m_waitMutex);
+            ++m_numWaiters;
+            boost::atomic_thread_fence(boost::memory_order_seq_cst);
+            while ((slot.cachedAvailable = getAvailable(reader)) <= next)
+            {
+              m_waitCond.wait(lock);
+            }
+            --m_numWaiters;
+          }
+        }
+        RABOTNIK_TRACE_BEGIN("BroadcastBufferQueue::read");
+        return *getBuffer(next);
+      }
+
+      void finishReading(unsigned int reader)
+      {
+        boost::atomic<sequence> & cursor = m_readers[reader].cursor.value;
+        cursor.store(cursor.load(boost::memory_order_relaxed) + 1);
+        notifyWaiters();
+        RABOTNIK_TRACE_END("BroadcastBufferQueue::read");
+      }
+
+      /**
+       * @param args Passed to the buffer constructor, if supported.
+       */
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      template<typename... _Args>
+      _Buffer & beginWriting(_Args &&... args)
+#else
+      _Buffer & beginWriting()
+#endif
+      {
+        sequence next = m_published.value.load(boost::memory_order_relaxed);
+        if (next >= m_cachedMinCursor + _BufferCount)
+        {
+          m_cachedMinCursor = getMinCursor();
+          if (next >= m_cachedMinCursor + _BufferCount)
+          {
+            RABOTNIK_TRACE_SCOPE("BroadcastBufferQueue::park");
+            boost::unique_lock<boost::mutex> lock(m_waitMutex);
+            ++m_numWaiters;
+            boost::atomic_thread_fence(boost::memory_order_seq_cst);
+            while (next >= (m_cachedMinCursor = getMinCursor()) + _BufferCount)
+            {
+              m_waitCond.wait(lock);
+            }
+            --m_numWaiters;
+          }
+        }
+
+        RABOTNIK_TRACE_BEGIN("BroadcastBufferQueue::write");
+        _Buffer * buffer = getBuffer(next);
+        if (next >= _BufferCount)
+        {
+          buffer->~_Buffer();
+        }
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+        new (buffer) _Buffer(std::forward<_Args>(args)...);
+#else
+        new (buffer) _Buffer();
+#endif
+        m_isWriting = true;
+        return *buffer;
+      }
+
+      void finishWriting()
+      {
+        m_isWriting = false;
+        m_published.value.store(
+            m_published.value.load(boost::memory_order_relaxed) + 1);
+        notifyWaiters();
+        RABOTNIK_TRACE_END("BroadcastBufferQueue::write");
+      }
+
+      ~BroadcastBufferQueue()
+      {
+        //A buffer begun but not finished replaces the oldest one.
+        sequence end = m_published.value.load() + (m_isWriting ? 1 : 0);
+        sequence s = end > _BufferCount ? end - _BufferCount : 0;
+        for (; s < end; ++s)
+        {
+          getBuffer(s)->~_Buffer();
+        }
+      }
+  };
+
+  /**
+   * @brief Read end of a BroadcastBufferQueue, usable as the buffer queue of
+   * a ReaderThread.
+   *
+   * Must be attached to a queue before the thread is started. Buffers are
+   * shared between readers and are thus read-only.
+   */
+  template<typename _BroadcastBufferQueue>
+  class BroadcastBufferQueueReader
+  {
+    _BroadcastBufferQueue * m_queue;
+    unsigned int m_reader;
+
+    public:
+      typedef const typename _BroadcastBufferQueue::buffer buffer;
+
+      BroadcastBufferQueueReader()
+        : m_queue(0),
+          m_reader(0)
+      {
+      }
+
+      /**
+       * @param reader Index returned by BroadcastBufferQueue::addReader().
+       */
+      void attach(_BroadcastBufferQueue & queue, unsigned int reader)
+      {
+        m_queue = &queue;
+        m_reader = reader;
+      }
+
+      unsigned int getReader() const
+      {
+        return m_reader;
+      }
+
+      buffer & beginReading()
+      {
+        return m_queue->beginReading(m_reader);
+      }
+
+      void finishReading()
+      {
+        m_queue->finishReading(m_reader);
+      }
+  };
+}
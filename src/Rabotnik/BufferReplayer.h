@@ -0,0 +1,114 @@
+#pragma once
+
+#include <Rabotnik/BufferSerializer.h>
+#include <Rabotnik/Internal/RecordingFile.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+#include <errno.h>
+#include <time.h>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Describes how fast BufferReplayer writes the buffers.
+   */
+  enum ReplayPacing {
+    /**
+     * @brief Write buffers as fast as the target accepts them.
+     */
+    REPLAY_AS_FAST_AS_POSSIBLE,
+    /**
+     * @brief Write buffers with the same intervals as they were recorded.
+     */
+    REPLAY_ORIGINAL_PACING,
+  };
+
+  /**
+   * @brief Replays a recording made with RecordingBufferQueue.
+   */
+  class BufferReplayer : boost::noncopyable
+  {
+    Internal::RecordingFileReader m_reader;
+
+    static boost::uint64_t now()
+    {
+      timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    static void sleepUntil(boost::uint64_t time)
+    {
+      timespec ts;
+      ts.tv_sec = time / 1000000000ULL;
+      ts.tv_nsec = time % 1000000000ULL;
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR)
+      {
+      }
+    }
+
+    public:
+      BufferReplayer(const char * path)
+        : m_reader(path)
+      {
+      }
+
+      /**
+       * @brief Writes the rest of the recording into target.
+       *
+       * @param target
+       *  Object having a buffer typedef, buffer & beginWriting() and
+       *  void finishWriting(), eg. ReaderThread.
+       * @return Number of buffers written.
+       */
+      template<typename _Target>
+      boost::uint64_t replay(
+          _Target & target,
+          ReplayPacing pacing = REPLAY_AS_FAST_AS_POSSIBLE)
+      {
+        return replay<typename _Target::buffer>(target, pacing);
+      }
+
+      /**
+       * @brief Writes the rest of the recording into target, for targets
+       * without a buffer typedef.
+       *
+       * @param target
+       *  Object having _Buffer & beginWriting() and void finishWriting().
+       * @return Number of buffers written.
+       */
+      template<typename _Buffer, typename _Target>
+      boost::uint64_t replay(
+          _Target & target,
+          ReplayPacing pacing = REPLAY_AS_FAST_AS_POSSIBLE)
+      {
+        boost::uint64_t numBuffers = 0;
+        boost::uint64_t firstTimestamp = 0;
+        boost::uint64_t startTime = 0;
+        boost::uint64_t timestamp;
+        while (m_reader.read(timestamp))
+        {
+          if (pacing == REPLAY_ORIGINAL_PACING)
+          {
+            if (!numBuffers)
+            {
+              firstTimestamp = timestamp;
+              startTime = now();
+            }
+            else if (timestamp > firstTimestamp)
+            {
+              sleepUntil(startTime + (timestamp - firstTimestamp));
+            }
+          }
+
+          _Buffer & buffer = target.beginWriting();
+          BufferSerializer<_Buffer>::read(
+              buffer, m_reader.getData(), m_reader.getSize());
+          target.finishWriting();
+          ++numBuffers;
+        }
+        return numBuffers;
+      }
+  };
+}
@@ -0,0 +1,91 @@
+#pragma once
+/**
+ * @file
+ * Contains BufferSerializer, which converts buffers to and from bytes for
+ * recording and replaying.
+ */
+
+#include <Rabotnik/Exception.h>
+#include <Rabotnik/StaticQueue.h>
+
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/has_trivial_copy.hpp>
+#include <cstring>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Converts buffers to and from bytes.
+   *
+   * The default stores trivially copyable buffers as they are. Specialize for
+   * other buffer types.
+   */
+  template<typename _Buffer>
+  struct BufferSerializer
+  {
+    BOOST_STATIC_ASSERT(boost::has_trivial_copy<_Buffer>::value);
+
+    static size_t getSize(const _Buffer & buffer)
+    {
+      return sizeof(_Buffer);
+    }
+
+    /**
+     * @param out At least getSize(buffer) bytes.
+     */
+    static void write(const _Buffer & buffer, char * out)
+    {
+      memcpy(out, &buffer, sizeof(_Buffer));
+    }
+
+    /**
+     * @param buffer Newly constructed buffer to fill.
+     */
+    static void read(_Buffer & buffer, const char * in, size_t size)
+    {
+      if (size != sizeof(_Buffer))
+      {
+        throw Exception("Invalid size in BufferSerializer::read().");
+      }
+      memcpy(&buffer, in, sizeof(_Buffer));
+    }
+  };
+
+  /**
+   * @brief Stores the items of a StaticQueue, which must be trivially
+   * copyable.
+   */
+  template<typename _T, size_t _NumItems>
+  struct BufferSerializer<StaticQueue<_T, _NumItems> >
+  {
+    BOOST_STATIC_ASSERT(boost::has_trivial_copy<_T>::value);
+
+    typedef StaticQueue<_T, _NumItems> queue;
+
+    static size_t getSize(const queue & buffer)
+    {
+      return buffer.length() * sizeof(_T);
+    }
+
+    static void write(const queue & buffer, char * out)
+    {
+      memcpy(out, buffer.begin(), buffer.length() * sizeof(_T));
+    }
+
+    static void read(queue & buffer, const char * in, size_t size)
+    {
+      if (size % sizeof(_T) || size / sizeof(_T) > _NumItems)
+      {
+        throw Exception("Invalid size in BufferSerializer::read().");
+      }
+      typename queue::writer w = buffer.beginWriting();
+      for (size_t i = 0; i < size; i += sizeof(_T))
+      {
+        _T item;
+        memcpy(&item, in + i, sizeof(_T));
+        w.push_back(item);
+      }
+      buffer.finishWriting(w);
+    }
+  };
+}
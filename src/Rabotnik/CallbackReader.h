@@ -1,8 +1,10 @@
 #pragma once
 
+#include <Rabotnik/Internal/BufferQueue.h>
 #include <Rabotnik/Internal/Callers.h>
 #include <Rabotnik/Internal/StateManager.h>
 #include <Rabotnik/Exception.h>
+#include <Rabotnik/PerfStats.h>
 
 #include <boost/bind.hpp>
 //Hack to get around getpagesize() working on iOS SDK where it is deprecated
@@ -10,6 +12,7 @@
 extern "C" { int getpagesize(); }
 
 #include <boost/thread.hpp>
+#include <utility>
 
 namespace Rabotnik
 {
@@ -35,7 +38,11 @@ namespace Rabotnik
   >
   class CallbackReader
   {
-    typedef typename _BufferQueue::buffer buffer;
+    public:
+      typedef typename _BufferQueue::buffer buffer;
+
+    private:
+    typedef typename Internal::ReadBuffer<_BufferQueue>::type read_buffer;
     boost::thread m_thread;
     bool m_isCallbackRunning;
 
@@ -45,7 +52,8 @@ namespace Rabotnik
 
     _CallbackManagerPtr m_callbackManager;
 
-    Internal::ProcessBufferCaller<_BufferHandler, buffer> m_processBufferCaller;
+    Internal::ProcessBufferCaller<_BufferHandler, read_buffer>
+      m_processBufferCaller;
 
     Internal::StateManager m_stateManager;
 
@@ -55,11 +63,22 @@ namespace Rabotnik
       {
       }
 
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      template<typename... _Args>
+      buffer & beginWriting(_Args &&... args)
+      {
+        return m_bufferQueue.beginWriting(std::forward<_Args>(args)...);
+      }
+#else
       buffer & beginWriting() { return m_bufferQueue.beginWriting(); }
+#endif
       void finishWriting() { m_bufferQueue.finishWriting(); }
 
       _BufferHandler & getBufferHandler() { return m_handler; }
       const _BufferHandler & getBufferHandler() const { return m_handler; }
+
+      _BufferQueue & getBufferQueue() { return m_bufferQueue; }
+      const _BufferQueue & getBufferQueue() const { return m_bufferQueue; }
       
       void callback() 
       {
@@ -67,16 +86,18 @@ namespace Rabotnik
         {
           case READER_STATE_STARTING:
             Internal::callInitializeThread(m_handler);
+            m_processBufferCaller.getPerfCounters().open();
             m_stateManager.setState(READER_STATE_RUNNING);
             //Fall-through to running.
           case READER_STATE_RUNNING:
             {
-              buffer & buffer = m_bufferQueue.beginReading();
+              read_buffer & buffer = m_bufferQueue.beginReading();
               m_processBufferCaller.call(m_handler, buffer);
               m_bufferQueue.finishReading();
             }
             break;
           case READER_STATE_STOPPING:
+            m_processBufferCaller.getPerfCounters().close();
             Internal::callUninitializeThread(m_handler);
             m_callbackManager->stopCallback();
             m_stateManager.setState(READER_STATE_STOPPED);
@@ -115,6 +136,25 @@ namespace Rabotnik
         m_stateManager.waitForState(state);
       }
 
+      /**
+       * @brief Enables or disables measuring processBuffer() with hardware
+       * performance counters. Takes effect when the callback starts.
+       */
+      void enablePerfCounters(bool isEnabled = true)
+      {
+        m_processBufferCaller.getPerfCounters().setEnabled(isEnabled);
+      }
+
+      PerfStats getPerfStats() const
+      {
+        return m_processBufferCaller.getPerfCounters().getStats();
+      }
+
+      void resetPerfStats()
+      {
+        m_processBufferCaller.getPerfCounters().resetStats();
+      }
+
       ~CallbackReader()
       {
         switch (m_stateManager.getState())
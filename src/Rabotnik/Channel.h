@@ -0,0 +1,226 @@
+#pragma once
+
+#include <Rabotnik/Internal/Callers.h>
+
+#include <boost/atomic.hpp>
+#include <boost/utility.hpp>
+#include <utility>
+
+namespace Rabotnik
+{
+  namespace Internal
+  {
+    class ChannelBase;
+
+    /**
+     * @brief Gets notified when a buffer has been written to a channel.
+     */
+    struct ChannelListener
+    {
+      inline virtual ~ChannelListener() { }
+      virtual void channelReady(ChannelBase & channel) = 0;
+    };
+
+    /**
+     * @brief Type-erased part of Channel, used by threads servicing several
+     * channels.
+     */
+    class ChannelBase : boost::noncopyable
+    {
+      ChannelListener * m_listener;
+      unsigned int m_listenerIndex;
+      boost::atomic<unsigned int> m_listenerState;
+
+      protected:
+        void notifyListener()
+        {
+          if (m_listener)
+          {
+            m_listener->channelReady(*this);
+          }
+        }
+
+      public:
+        ChannelBase()
+          : m_listener(0),
+            m_listenerIndex(0),
+            m_listenerState(0)
+        {
+        }
+
+        inline virtual ~ChannelBase() { }
+
+        /**
+         * @param listener Listener to notify, or NULL.
+         * @param index Index of the channel, for the use of the listener.
+         */
+        void setListener(ChannelListener * listener, unsigned int index = 0)
+        {
+          m_listener = listener;
+          m_listenerIndex = index;
+        }
+
+        unsigned int getListenerIndex() const
+        {
+          return m_listenerIndex;
+        }
+
+        /**
+         * @brief Scheduling state of the channel, for the use of the
+         * listener.
+         */
+        boost::atomic<unsigned int> & getListenerState()
+        {
+          return m_listenerState;
+        }
+
+        virtual void initializeThread() = 0;
+        virtual void uninitializeThread() = 0;
+
+        /**
+         * @return True if the handler has initializeThread() or
+         * uninitializeThread().
+         */
+        virtual bool hasThreadHooks() const = 0;
+
+        /**
+         * @brief Processes full buffers without waiting for more.
+         *
+         * @param maxBuffers Maximum number of buffers to process.
+         * @return Number of buffers processed.
+         */
+        virtual unsigned int processBuffers(unsigned int maxBuffers) = 0;
+    };
+  }
+
+  /**
+   * @brief Buffer queue with its handler, serviced by a thread shared with
+   * other channels (eg. MultiplexReaderThread).
+   *
+   * @param _BufferQueue
+   *  Buffer queue having _Buffer * tryBeginReading(), eg. PushBufferQueue.
+   *
+   * @param _BufferHandler
+   *  Type to handle the events, as in ReaderThread.
+   */
+  template<
+    typename _BufferQueue,
+    typename _BufferHandler
+  >
+  class Channel : public Internal::ChannelBase
+  {
+    public:
+      typedef typename _BufferQueue::buffer buffer;
+
+    private:
+
+    _BufferQueue m_bufferQueue;
+
+    _BufferHandler m_handler;
+
+    Internal::ProcessBufferCaller<_BufferHandler, buffer> m_processBufferCaller;
+
+    public:
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      template<typename... _Args>
+      buffer & beginWriting(_Args &&... args)
+      {
+        return m_bufferQueue.beginWriting(std::forward<_Args>(args)...);
+      }
+#else
+      buffer & beginWriting() { return m_bufferQueue.beginWriting(); }
+#endif
+
+      void finishWriting()
+      {
+        m_bufferQueue.finishWriting();
+        notifyListener();
+      }
+
+      _BufferHandler & getBufferHandler() { return m_handler; }
+      const _BufferHandler & getBufferHandler() const { return m_handler; }
+
+      _BufferQueue & getBufferQueue() { return m_bufferQueue; }
+      const _BufferQueue & getBufferQueue() const { return m_bufferQueue; }
+
+      void initializeThread()
+      {
+        Internal::callInitializeThread(m_handler);
+      }
+
+      void uninitializeThread()
+      {
+        Internal::callUninitializeThread(m_handler);
+      }
+
+      bool hasThreadHooks() const
+      {
+        return Internal::HasMemberFunction_initializeThread<
+            _BufferHandler, void (_BufferHandler::*)()>::value
+          || Internal::HasMemberFunction_uninitializeThread<
+            _BufferHandler, void (_BufferHandler::*)()>::value;
+      }
+
+      unsigned int processBuffers(unsigned int maxBuffers)
+      {
+        unsigned int numProcessed = 0;
+        while (numProcessed < maxBuffers)
+        {
+          buffer * buffer = m_bufferQueue.tryBeginReading();
+          if (!buffer)
+          {
+            break;
+          }
+          m_processBufferCaller.call(m_handler, *buffer);
+          m_bufferQueue.finishReading();
+          ++numProcessed;
+        }
+        return numProcessed;
+      }
+
+      Channel()
+      {
+      }
+
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      /**
+       * @param args Forwarded to the handler constructor.
+       */
+      template<typename... _Args>
+      Channel(_Args &&... args)
+        : m_handler(std::forward<_Args>(args)...)
+      {
+      }
+#else
+      /**
+       * @param arg1 Passed to the handler constructor.
+       */
+      template<typename _Arg1>
+      Channel(_Arg1 arg1)
+        : m_handler(arg1)
+      {
+      }
+
+      /**
+       * @param arg1 Passed to the handler constructor.
+       * @param arg2 Passed to the handler constructor.
+       */
+      template<typename _Arg1, typename _Arg2>
+      Channel(_Arg1 arg1, _Arg2 arg2)
+        : m_handler(arg1, arg2)
+      {
+      }
+
+      /**
+       * @param arg1 Passed to the handler constructor.
+       * @param arg2 Passed to the handler constructor.
+       * @param arg3 Passed to the handler constructor.
+       */
+      template<typename _Arg1, typename _Arg2, typename _Arg3>
+      Channel(_Arg1 arg1, _Arg2 arg2, _Arg3 arg3)
+        : m_handler(arg1, arg2, arg3)
+      {
+      }
+#endif
+  };
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <Rabotnik/Exception.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+#include <time.h>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Producer-side writer which appends single items into the current
+   * buffer and publishes the buffer only when it is full, when it has grown
+   * past a size threshold, when its first item is older than a time threshold,
+   * or on flush().
+   *
+   * The buffer being filled is held open between calls, so each writer must
+   * only be used by one producer thread, and the target should be push-style
+   * (eg. ReaderThread with PushBufferQueue). With a PullBufferQueue, the
+   * reader would be locked out until the buffer is published.
+   *
+   * The time threshold is checked when items are added and when poll() is
+   * called. A producer that may go idle should call poll() periodically to
+   * bound the latency of the last items written.
+   *
+   * @param _Buffer Type of the buffer, eg. StaticQueue.
+   * @param _Target
+   *  Object having _Buffer & beginWriting() and void finishWriting(), eg.
+   *  ReaderThread or PushBufferQueue.
+   */
+  template<typename _Buffer, typename _Target>
+  class CoalescingWriter : boost::noncopyable
+  {
+    typedef typename _Buffer::value_type value_type;
+    typedef typename _Buffer::writer writer;
+
+    _Target & m_target;
+
+    _Buffer * m_buffer;
+    writer m_writer;
+    size_t m_numItems;
+    boost::uint64_t m_firstItemTime;
+
+    size_t m_maxItems;
+    boost::uint64_t m_maxLatencyNsec;
+
+    static boost::uint64_t now()
+    {
+      timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    void open()
+    {
+      m_buffer = &m_target.beginWriting();
+      m_writer = m_buffer->beginWriting();
+      m_numItems = 0;
+      if (m_maxLatencyNsec)
+      {
+        m_firstItemTime = now();
+      }
+    }
+
+    bool isStale() const
+    {
+      return m_maxLatencyNsec && now() - m_firstItemTime >= m_maxLatencyNsec;
+    }
+
+    public:
+      /**
+       * @param target Target to publish the buffers to.
+       */
+      CoalescingWriter(_Target & target)
+        : m_target(target),
+          m_buffer(0),
+          m_numItems(0),
+          m_firstItemTime(0),
+          m_maxItems(_Buffer::capacity),
+          m_maxLatencyNsec(0)
+      {
+      }
+
+      /**
+       * @brief Sets the number of items after which the buffer is published.
+       * Defaults to, and is limited by, the capacity of the buffer.
+       */
+      void setMaxItems(size_t maxItems)
+      {
+        if (!maxItems)
+        {
+          throw Exception("Max items must be nonzero.");
+        }
+        m_maxItems = maxItems < _Buffer::capacity
+          ? maxItems
+          : _Buffer::capacity;
+      }
+
+      /**
+       * @brief Sets the age of the first item after which the buffer is
+       * published. Zero (default) disables the time threshold.
+       */
+      void setMaxLatency(boost::uint64_t nsec)
+      {
+        m_maxLatencyNsec = nsec;
+      }
+
+      void push_back(const value_type & item)
+      {
+        if (!m_buffer)
+        {
+          open();
+        }
+        m_writer.push_back(item);
+        if (++m_numItems >= m_maxItems || isStale())
+        {
+          flush();
+        }
+      }
+
+      /**
+       * @brief Publishes the buffer if the time threshold has passed.
+       */
+      void poll()
+      {
+        if (m_buffer && isStale())
+        {
+          flush();
+        }
+      }
+
+      /**
+       * @brief Publishes the buffer being filled, if any.
+       */
+      void flush()
+      {
+        if (m_buffer)
+        {
+          m_buffer->finishWriting(m_writer);
+          m_target.finishWriting();
+          m_buffer = 0;
+        }
+      }
+
+      size_t getNumPendingItems() const
+      {
+        return m_buffer ? m_numItems : 0;
+      }
+
+      ~CoalescingWriter()
+      {
+        flush();
+      }
+  };
+}
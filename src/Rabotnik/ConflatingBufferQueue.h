@@ -0,0 +1,223 @@
+#pragma once
+
+#include <Rabotnik/Exception.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/Trace.h>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/utility.hpp>
+
+#include <utility>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Merge function of ConflatingBufferQueue keeping the newest value.
+   */
+  template<typename _Value>
+  struct ConflateToLatest
+  {
+    void operator()(_Value & pending, const _Value & update) const
+    {
+      pending = update;
+    }
+  };
+
+  /**
+   * @brief Buffer queue keeping only the pending value of each key, for
+   * streams of updates where the reader only needs the newest state.
+   *
+   * Use as the buffer queue of a ReaderThread, and write with
+   * getBufferQueue().update(). An update of a key that is pending is merged
+   * into its pending value, so the memory is bounded by the number of keys
+   * and update() never waits for the reader, only for the short critical
+   * sections of other calls. beginReading() waits for a pending key, and
+   * then takes the pending value of each key, in the order the keys became
+   * pending, into a buffer of std::pair<_Key, _Value> entries.
+   *
+   * Any number of threads may update.
+   *
+   * @param _Key Type of the keys, hashed with boost::hash.
+   * @param _Value Type of the values. Must be default-constructible.
+   * @param _MaxKeys
+   *  Maximum number of distinct keys. update() throws for more keys.
+   * @param _Merge
+   *  Functor with void operator()(_Value & pending, const _Value & update),
+   *  called when a key is updated while it is pending.
+   */
+  template<
+    typename _Key,
+    typename _Value,
+    unsigned int _MaxKeys,
+    typename _Merge = ConflateToLatest<_Value>
+  >
+  class ConflatingBufferQueue : boost::noncopyable
+  {
+    BOOST_STATIC_ASSERT(_MaxKeys > 0);
+
+    public:
+      typedef std::pair<_Key, _Value> entry;
+      typedef StaticQueue<entry, _MaxKeys> buffer;
+
+    private:
+      /**
+       * @brief Mask of slot indices. The number of slots is a power of two
+       * at least twice _MaxKeys.
+       */
+      static const unsigned int m_slotMask
+        = (_MaxKeys * 2 - 1) | ((_MaxKeys * 2 - 1) >> 1)
+          | ((_MaxKeys * 2 - 1) >> 2) | ((_MaxKeys * 2 - 1) >> 4)
+          | ((_MaxKeys * 2 - 1) >> 8) | ((_MaxKeys * 2 - 1) >> 16);
+      static const unsigned int m_noSlot = ~0U;
+
+      struct Slot
+      {
+        bool isUsed;
+        bool isPending;
+        /**
+         * @brief Next pending slot, or m_noSlot.
+         */
+        unsigned int next;
+        _Key key;
+        _Value value;
+
+        Slot()
+          : isUsed(false),
+            isPending(false),
+            next(m_noSlot)
+        {
+        }
+      };
+
+      Slot m_slots[m_slotMask + 1];
+      unsigned int m_numKeys;
+
+      /**
+       * @brief Pending slots, oldest first.
+       */
+      unsigned int m_pendingHead;
+      unsigned int m_pendingTail;
+
+      boost::mutex m_mutex;
+      boost::condition_variable m_pendingCond;
+      bool m_isReaderWaiting;
+
+      _Merge m_merge;
+
+      buffer m_buffer;
+
+      boost::atomic<boost::uint64_t> m_numConflated;
+
+      Slot & findSlot(const _Key & key)
+      {
+        unsigned int i = boost::hash<_Key>()(key) & m_slotMask;
+        while (m_slots[i].isUsed && !(m_slots[i].key == key))
+        {
+          i = (i + 1) & m_slotMask;
+        }
+        return m_slots[i];
+      }
+
+    public:
+      ConflatingBufferQueue(const _Merge & merge = _Merge())
+        : m_numKeys(0),
+          m_pendingHead(m_noSlot),
+          m_pendingTail(m_noSlot),
+          m_isReaderWaiting(false),
+          m_merge(merge),
+          m_numConflated(0)
+      {
+      }
+
+      /**
+       * @brief Makes value pending for key, or merges it into the pending
+       * value of key.
+       */
+      void update(const _Key & key, const _Value & value)
+      {
+        bool isReaderWaiting;
+        {
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          Slot & slot = findSlot(key);
+          if (slot.isPending)
+          {
+            m_merge(slot.value, value);
+            m_numConflated.fetch_add(1, boost::memory_order_relaxed);
+            return;
+          }
+          if (!slot.isUsed)
+          {
+            if (m_numKeys == _MaxKeys)
+            {
+              throw Exception("Too many keys in ConflatingBufferQueue.");
+            }
+            ++m_numKeys;
+            slot.isUsed = true;
+            slot.key = key;
+          }
+          slot.value = value;
+          slot.isPending = true;
+          slot.next = m_noSlot;
+          unsigned int index = &slot - m_slots;
+          if (m_pendingTail == m_noSlot)
+          {
+            m_pendingHead = index;
+          }
+          else
+          {
+            m_slots[m_pendingTail].next = index;
+          }
+          m_pendingTail = index;
+          isReaderWaiting = m_isReaderWaiting;
+        }
+        if (isReaderWaiting)
+        {
+          m_pendingCond.notify_one();
+        }
+      }
+
+      buffer & beginReading()
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        if (m_pendingHead == m_noSlot)
+        {
+          RABOTNIK_TRACE_SCOPE("ConflatingBufferQueue::park");
+          m_isReaderWaiting = true;
+          while (m_pendingHead == m_noSlot)
+          {
+            m_pendingCond.wait(lock);
+          }
+          m_isReaderWaiting = false;
+        }
+        RABOTNIK_TRACE_BEGIN("ConflatingBufferQueue::read");
+        for (unsigned int i = m_pendingHead; i != m_noSlot; i = m_slots[i].next)
+        {
+          Slot & slot = m_slots[i];
+          m_buffer.push_back(entry(slot.key, slot.value));
+          slot.isPending = false;
+        }
+        m_pendingHead = m_pendingTail = m_noSlot;
+        return m_buffer;
+      }
+
+      void finishReading()
+      {
+        m_buffer.clear();
+        RABOTNIK_TRACE_END("ConflatingBufferQueue::read");
+      }
+
+      /**
+       * @return Number of updates merged into a pending value.
+       */
+      boost::uint64_t getNumConflated() const
+      {
+        return m_numConflated.load(boost::memory_order_relaxed);
+      }
+  };
+}
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <Rabotnik/Internal/Callers.h>
+#include <Rabotnik/Internal/StateManager.h>
+#include <Rabotnik/Exception.h>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+
+#include <boost/thread.hpp>
+#include <time.h>
+#include <utility>
+#include <vector>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Group of reader threads sharing a multi-consumer buffer queue,
+   * growing and shrinking with the load.
+   *
+   * A controller thread samples the queue on a fixed interval. When the
+   * share of full buffers or the age of the oldest full buffer stays at or
+   * above its threshold for the scale-up delay, a worker is added. When the
+   * workers have been busy less than the scale-down utilization over the
+   * whole scale-down delay, the newest worker is retired after it finishes
+   * its buffer. The number of workers stays within the bounds.
+   *
+   * Each worker has its own copy of the handler, on which initializeThread()
+   * and uninitializeThread() are called on the worker thread when it is
+   * started and retired.
+   *
+   * @param _BufferQueue
+   *  Buffer queue having _Buffer * beginReading(timeout),
+   *  finishReading(_Buffer &), wakeReaders(), getNumFullBuffers(),
+   *  getLagNsec() and bufferCount, eg. MultiConsumerBufferQueue.
+   *
+   * @param _BufferHandler
+   *  Type to handle the events, as in ReaderThread. Must be copyable.
+   */
+  template<
+    typename _BufferQueue,
+    typename _BufferHandler
+  >
+  class ElasticReaderGroup : boost::noncopyable
+  {
+    public:
+      typedef typename _BufferQueue::buffer buffer;
+
+    private:
+
+    struct Worker
+    {
+      _BufferHandler handler;
+      Internal::ProcessBufferCaller<_BufferHandler, buffer>
+        processBufferCaller;
+      boost::thread thread;
+      boost::atomic<bool> isRetiring;
+      /**
+       * @brief Time spent processing buffers since the controller last took
+       * it.
+       */
+      boost::atomic<boost::uint64_t> busyNsec;
+
+      Worker(const _BufferHandler & handler)
+        : handler(handler),
+          isRetiring(false),
+          busyNsec(0)
+      {
+      }
+    };
+
+    _BufferQueue m_bufferQueue;
+
+    _BufferHandler m_handler;
+
+    /**
+     * @brief Changed only by the controller thread.
+     */
+    std::vector<Worker *> m_workers;
+    mutable boost::mutex m_workersMutex;
+
+    boost::thread m_controller;
+
+    Internal::StateManager m_stateManager;
+
+    unsigned int m_minWorkers;
+    unsigned int m_maxWorkers;
+    unsigned int m_scaleUpOccupancyPercent;
+    boost::uint64_t m_scaleUpLagNsec;
+    boost::uint64_t m_scaleUpDelayNsec;
+    unsigned int m_scaleDownUtilizationPercent;
+    boost::uint64_t m_scaleDownDelayNsec;
+    boost::uint64_t m_sampleIntervalNsec;
+
+    static boost::uint64_t now()
+    {
+      timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    void workerLoop(Worker * worker)
+    {
+      Internal::callInitializeThread(worker->handler);
+      boost::posix_time::time_duration timeout
+        = boost::posix_time::microseconds(m_sampleIntervalNsec / 1000 + 1);
+      while (!worker->isRetiring)
+      {
+        buffer * buffer = m_bufferQueue.beginReading(timeout);
+        if (buffer)
+        {
+          boost::uint64_t begin = now();
+          worker->processBufferCaller.call(worker->handler, *buffer);
+          m_bufferQueue.finishReading(*buffer);
+          worker->busyNsec.fetch_add(
+              now() - begin, boost::memory_order_relaxed);
+        }
+      }
+      Internal::callUninitializeThread(worker->handler);
+    }
+
+    void addWorker()
+    {
+      Worker * worker = new Worker(m_handler);
+      worker->thread = boost::thread(
+          boost::bind(&ElasticReaderGroup::workerLoop, this, worker));
+      boost::unique_lock<boost::mutex> lock(m_workersMutex);
+      m_workers.push_back(worker);
+    }
+
+    void retireWorker()
+    {
+      Worker * worker = m_workers.back();
+      worker->isRetiring = true;
+      m_bufferQueue.wakeReaders();
+      worker->thread.join();
+      boost::unique_lock<boost::mutex> lock(m_workersMutex);
+      m_workers.pop_back();
+      delete worker;
+    }
+
+    void controllerLoop()
+    {
+      while (m_workers.size() < m_minWorkers)
+      {
+        addWorker();
+      }
+      m_stateManager.setState(READER_STATE_RUNNING);
+
+      boost::uint64_t lastSample = now();
+      boost::uint64_t overloadedSince = 0;
+      boost::uint64_t windowBusyNsec = 0;
+      boost::uint64_t windowNsec = 0;
+      while (m_stateManager.getState() == READER_STATE_RUNNING)
+      {
+        boost::this_thread::sleep(
+            boost::posix_time::microseconds(m_sampleIntervalNsec / 1000));
+
+        boost::uint64_t sample = now();
+        boost::uint64_t elapsed = sample - lastSample;
+        lastSample = sample;
+        boost::uint64_t busyNsec = 0;
+        for (size_t i = 0; i < m_workers.size(); ++i)
+        {
+          busyNsec += m_workers[i]->busyNsec.exchange(0);
+        }
+
+        unsigned int numWorkers = m_workers.size();
+        bool isOverloaded
+          = m_bufferQueue.getNumFullBuffers() * 100
+            >= _BufferQueue::bufferCount * m_scaleUpOccupancyPercent
+          || m_bufferQueue.getLagNsec() >= m_scaleUpLagNsec;
+
+        if (isOverloaded)
+        {
+          windowBusyNsec = windowNsec = 0;
+          if (!overloadedSince)
+          {
+            overloadedSince = sample;
+          }
+          if (sample - overloadedSince >= m_scaleUpDelayNsec)
+          {
+            if (numWorkers < m_maxWorkers)
+            {
+              addWorker();
+            }
+            overloadedSince = 0;
+          }
+          continue;
+        }
+
+        overloadedSince = 0;
+        windowBusyNsec += busyNsec;
+        windowNsec += elapsed;
+        if (windowNsec >= m_scaleDownDelayNsec)
+        {
+          if (numWorkers > m_minWorkers
+              && windowBusyNsec * 100
+                < windowNsec * numWorkers * m_scaleDownUtilizationPercent)
+          {
+            retireWorker();
+          }
+          windowBusyNsec = windowNsec = 0;
+        }
+      }
+
+      while (!m_workers.empty())
+      {
+        retireWorker();
+      }
+      m_stateManager.setState(READER_STATE_STOPPED);
+    }
+
+    public:
+      /**
+       * @param handler Handler copied to each worker.
+       */
+      ElasticReaderGroup(const _BufferHandler & handler = _BufferHandler())
+        : m_handler(handler),
+          m_minWorkers(1),
+          m_maxWorkers(boost::thread::hardware_concurrency()),
+          m_scaleUpOccupancyPercent(50),
+          m_scaleUpLagNsec(1000000),
+          m_scaleUpDelayNsec(10000000),
+          m_scaleDownUtilizationPercent(25),
+          m_scaleDownDelayNsec(1000000000),
+          m_sampleIntervalNsec(1000000)
+      {
+        if (!m_maxWorkers)
+        {
+          m_maxWorkers = 1;
+        }
+      }
+
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      template<typename... _Args>
+      buffer & beginWriting(_Args &&... args)
+      {
+        return m_bufferQueue.beginWriting(std::forward<_Args>(args)...);
+      }
+#else
+      buffer & beginWriting() { return m_bufferQueue.beginWriting(); }
+#endif
+      void finishWriting() { m_bufferQueue.finishWriting(); }
+
+      /**
+       * @brief Sets the minimum and maximum number of workers. Must be called
+       * when the group is stopped. Defaults to 1 and one per core.
+       */
+      void setWorkerBounds(unsigned int minWorkers, unsigned int maxWorkers)
+      {
+        if (!minWorkers || minWorkers > maxWorkers)
+        {
+          throw Exception("Invalid worker bounds.");
+        }
+        m_minWorkers = minWorkers;
+        m_maxWorkers = maxWorkers;
+      }
+
+      /**
+       * @brief Sets when the group is overloaded: when at least
+       * occupancyPercent of the buffers are full, or the oldest full buffer
+       * was written at least lagNsec ago. Default to 50 % and 1 ms.
+       */
+      void setScaleUpThresholds(
+          unsigned int occupancyPercent, boost::uint64_t lagNsec)
+      {
+        m_scaleUpOccupancyPercent = occupancyPercent;
+        m_scaleUpLagNsec = lagNsec;
+      }
+
+      /**
+       * @brief Sets how long the group must be overloaded before a worker is
+       * added. Defaults to 10 ms.
+       */
+      void setScaleUpDelay(boost::uint64_t nsec)
+      {
+        m_scaleUpDelayNsec = nsec;
+      }
+
+      /**
+       * @brief Sets the utilization of the workers under which a worker is
+       * retired. Defaults to 25 %.
+       */
+      void setScaleDownUtilization(unsigned int percent)
+      {
+        m_scaleDownUtilizationPercent = percent;
+      }
+
+      /**
+       * @brief Sets how long the utilization must stay low before a worker is
+       * retired. Defaults to one second.
+       */
+      void setScaleDownDelay(boost::uint64_t nsec)
+      {
+        m_scaleDownDelayNsec = nsec;
+      }
+
+      /**
+       * @brief Sets how often the controller samples the queue. Defaults to
+       * one millisecond.
+       */
+      void setSampleInterval(boost::uint64_t nsec)
+      {
+        if (nsec < 1000)
+        {
+          throw Exception("Sample interval must be at least 1 usec.");
+        }
+        m_sampleIntervalNsec = nsec;
+      }
+
+      unsigned int getNumWorkers() const
+      {
+        boost::unique_lock<boost::mutex> lock(m_workersMutex);
+        return m_workers.size();
+      }
+
+      _BufferQueue & getBufferQueue()
+      {
+        return m_bufferQueue;
+      }
+
+      const _BufferQueue & getBufferQueue() const
+      {
+        return m_bufferQueue;
+      }
+
+      void start()
+      {
+        if (m_stateManager.getState() != READER_STATE_STOPPED)
+        {
+          throw Exception("The group is not stopped.");
+        }
+        m_stateManager.setState(READER_STATE_STARTING);
+        m_controller = boost::thread(
+            boost::bind(&ElasticReaderGroup::controllerLoop, this));
+      }
+
+      /**
+       * @brief Retires all workers after they finish their current buffers.
+       */
+      void stop()
+      {
+        m_stateManager.setState(READER_STATE_STOPPING);
+      }
+
+      void join()
+      {
+        m_controller.join();
+      }
+
+      void waitForState(ReaderState state) const
+      {
+        m_stateManager.waitForState(state);
+      }
+
+      ~ElasticReaderGroup()
+      {
+        switch (m_stateManager.getState())
+        {
+          case READER_STATE_STARTING:
+            waitForState(READER_STATE_RUNNING);
+            stop();
+            join();
+            break;
+          case READER_STATE_RUNNING:
+            stop();
+            join();
+            break;
+          case READER_STATE_STOPPING:
+            join();
+            break;
+          default:
+            break;
+        }
+      }
+  };
+}
@@ -0,0 +1,189 @@
+#pragma once
+/**
+ * @file
+ * Contains FusedHandler, which chains several item-processing stages into a
+ * single buffer handler.
+ */
+
+#include <Rabotnik/Internal/Callers.h>
+
+#include <boost/range/begin.hpp>
+#include <boost/range/end.hpp>
+#include <boost/range/iterator.hpp>
+
+namespace Rabotnik
+{
+  namespace Internal
+  {
+    /**
+     * @brief Placeholder for unused stages of FusedHandler.
+     */
+    struct NoStage
+    {
+    };
+
+    /**
+     * @brief Sink after the last stage, discards everything.
+     */
+    struct NullSink
+    {
+      template<typename _Item>
+      void operator()(const _Item & /*item*/)
+      {
+      }
+
+      void initialize()
+      {
+      }
+
+      void uninitialize()
+      {
+      }
+    };
+
+    /**
+     * @brief Stage of a fused chain, acting as the sink of the previous
+     * stage.
+     */
+    template<typename _Stage, typename _Next>
+    class FusedStage
+    {
+      _Stage m_stage;
+      _Next m_next;
+
+      public:
+        typedef _Stage stage;
+        typedef _Next next;
+
+        template<typename _Item>
+        void operator()(const _Item & item)
+        {
+          m_stage.processItem(item, m_next);
+        }
+
+        void initialize()
+        {
+          callInitializeThread(m_stage);
+          m_next.initialize();
+        }
+
+        void uninitialize()
+        {
+          callUninitializeThread(m_stage);
+          m_next.uninitialize();
+        }
+
+        _Stage & getStage() { return m_stage; }
+        _Next & getNext() { return m_next; }
+    };
+
+    template<
+      typename _S1, typename _S2, typename _S3,
+      typename _S4, typename _S5, typename _S6
+    >
+    struct MakeFusedChain
+    {
+      typedef FusedStage<
+        _S1,
+        typename MakeFusedChain<_S2, _S3, _S4, _S5, _S6, NoStage>::type
+      > type;
+    };
+
+    template<>
+    struct MakeFusedChain<
+      NoStage, NoStage, NoStage, NoStage, NoStage, NoStage
+    >
+    {
+      typedef NullSink type;
+    };
+
+    template<typename _Chain, unsigned int _Index>
+    struct FusedStageAt
+    {
+      typedef FusedStageAt<typename _Chain::next, _Index - 1> next_at;
+      typedef typename next_at::type type;
+
+      static type & get(_Chain & chain)
+      {
+        return next_at::get(chain.getNext());
+      }
+    };
+
+    template<typename _Chain>
+    struct FusedStageAt<_Chain, 0>
+    {
+      typedef typename _Chain::stage type;
+
+      static type & get(_Chain & chain)
+      {
+        return chain.getStage();
+      }
+    };
+  }
+
+  /**
+   * @brief Buffer handler passing each item of the buffer through a chain of
+   * stages, without intermediate buffers.
+   *
+   * Each stage must have
+   * template<typename _Sink> void processItem(const Item & item, _Sink & sink),
+   * and calls sink(output) zero or more times for each item. The output of
+   * the last stage is discarded. Stages may have void initializeThread()
+   * and/or void uninitializeThread(), which are called in the order of the
+   * stages.
+   *
+   * The whole chain is visible to the compiler, so stages get inlined into a
+   * single loop over the buffer.
+   *
+   * @param _S1 ... _S6 Types of the stages, default-constructed. Unused
+   *  stages are left as Internal::NoStage.
+   */
+  template<
+    typename _S1,
+    typename _S2 = Internal::NoStage,
+    typename _S3 = Internal::NoStage,
+    typename _S4 = Internal::NoStage,
+    typename _S5 = Internal::NoStage,
+    typename _S6 = Internal::NoStage
+  >
+  class FusedHandler
+  {
+    typedef typename Internal::MakeFusedChain<
+      _S1, _S2, _S3, _S4, _S5, _S6
+    >::type chain;
+
+    chain m_chain;
+
+    public:
+      void initializeThread()
+      {
+        m_chain.initialize();
+      }
+
+      void uninitializeThread()
+      {
+        m_chain.uninitialize();
+      }
+
+      template<typename _Buffer>
+      void processBuffer(_Buffer & buffer)
+      {
+        typedef typename boost::range_iterator<_Buffer>::type iterator;
+        iterator end = boost::end(buffer);
+        for (iterator it = boost::begin(buffer); it != end; ++it)
+        {
+          m_chain(*it);
+        }
+      }
+
+      /**
+       * @brief Returns the stage at _Index, eg. to configure it or to read its
+       * results.
+       */
+      template<unsigned int _Index>
+      typename Internal::FusedStageAt<chain, _Index>::type & getStage()
+      {
+        return Internal::FusedStageAt<chain, _Index>::get(m_chain);
+      }
+  };
+}
@@ -0,0 +1,576 @@
+#pragma once
+
+#include <Rabotnik/Internal/CacheLine.h>
+#include <Rabotnik/Internal/Parker.h>
+#include <Rabotnik/Exception.h>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/utility.hpp>
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <time.h>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Rabotnik
+{
+  /**
+   * @brief Describes how HelperTeam splits a range between its threads.
+   */
+  enum HelperSchedule {
+    /**
+     * @brief The threads take chunks in turn until none are left, which
+     * balances chunks of uneven cost.
+     */
+    HELPER_SCHEDULE_DYNAMIC,
+    /**
+     * @brief Each thread runs the chunks of its own equal part of the range,
+     * so a thread works on the same part of every buffer and the threads do
+     * not contend for chunks.
+     */
+    HELPER_SCHEDULE_STATIC,
+  };
+
+  namespace Internal
+  {
+    /**
+     * @brief Work shared by the threads of a HelperTeam for one call.
+     */
+    class HelperJob
+    {
+      boost::atomic<size_t> m_nextChunk;
+      size_t m_size;
+      size_t m_grainSize;
+      /**
+       * @brief Number of parts the range is split into, or 0 if the chunks
+       * are taken in turn.
+       */
+      unsigned int m_numParts;
+      boost::atomic<bool> m_isFailed;
+
+      protected:
+        virtual void runChunk(unsigned int thread, size_t begin, size_t end)
+          = 0;
+
+      public:
+        HelperJob(size_t size, size_t grainSize, unsigned int numParts)
+          : m_nextChunk(0),
+            m_size(size),
+            m_grainSize(grainSize),
+            m_numParts(numParts),
+            m_isFailed(false)
+        {
+        }
+
+        /**
+         * @brief Runs the chunks of part thread, or chunks until there are
+         * none left.
+         *
+         * @param thread 0 for the calling thread, 1 to N for the helpers.
+         */
+        void run(unsigned int thread)
+        {
+          if (m_numParts)
+          {
+            size_t end = m_size * (thread + 1) / m_numParts;
+            for (size_t begin = m_size * thread / m_numParts;
+                begin < end && !m_isFailed.load(boost::memory_order_relaxed);
+                begin += m_grainSize)
+            {
+              runChunk(thread, begin, std::min(end, begin + m_grainSize));
+            }
+            return;
+          }
+          for (;;)
+          {
+            size_t begin = m_nextChunk.fetch_add(
+                m_grainSize, boost::memory_order_relaxed);
+            if (begin >= m_size)
+            {
+              return;
+            }
+            runChunk(thread, begin, std::min(m_size, begin + m_grainSize));
+          }
+        }
+
+        /**
+         * @brief Makes the remaining chunks be skipped.
+         */
+        void fail()
+        {
+          m_isFailed = true;
+          m_nextChunk.store(m_size);
+        }
+
+        bool isFailed() const
+        {
+          return m_isFailed;
+        }
+
+        virtual ~HelperJob()
+        {
+        }
+    };
+
+    template<typename _Iterator, typename _Function>
+    class HelperForJob : public HelperJob
+    {
+      _Iterator m_begin;
+      _Function & m_function;
+
+      protected:
+        void runChunk(unsigned int /*thread*/, size_t begin, size_t end)
+        {
+          m_function(m_begin + begin, m_begin + end);
+        }
+
+      public:
+        HelperForJob(_Iterator begin, _Iterator end, size_t grainSize,
+            unsigned int numParts, _Function & function)
+          : HelperJob(end - begin, grainSize, numParts),
+            m_begin(begin),
+            m_function(function)
+        {
+        }
+    };
+
+    template<
+      typename _Iterator,
+      typename _T,
+      typename _Reduce,
+      typename _Combine
+    >
+    class HelperReduceJob : public HelperJob
+    {
+      _Iterator m_begin;
+      _Reduce & m_reduce;
+      _Combine & m_combine;
+      /**
+       * @brief Result of each thread, padded since each thread writes its
+       * own.
+       */
+      std::vector<CacheLinePadded<_T> > m_partials;
+
+      protected:
+        void runChunk(unsigned int thread, size_t begin, size_t end)
+        {
+          _T & partial = m_partials[thread].value;
+          partial = m_combine(partial, m_reduce(m_begin + begin, m_begin + end));
+        }
+
+      public:
+        HelperReduceJob(_Iterator begin, _Iterator end, size_t grainSize,
+            unsigned int numThreads, unsigned int numParts,
+            const _T & identity, _Reduce & reduce, _Combine & combine)
+          : HelperJob(end - begin, grainSize, numParts),
+            m_begin(begin),
+            m_reduce(reduce),
+            m_combine(combine),
+            m_partials(numThreads, CacheLinePadded<_T>(identity))
+        {
+        }
+
+        _T getResult() const
+        {
+          _T result = m_partials[0].value;
+          for (size_t i = 1; i < m_partials.size(); ++i)
+          {
+            result = m_combine(result, m_partials[i].value);
+          }
+          return result;
+        }
+    };
+  }
+
+  /**
+   * @brief Team of helper threads running loops over large buffers in
+   * parallel with the reader thread.
+   *
+   * Meant to be a member of a handler, started in its initializeThread() and
+   * stopped in its uninitializeThread(), so that processBuffer() can call
+   * parallelFor() and parallelReduce() over the buffer. These return when
+   * all of the range is done, ie. before the buffer is finished. Only the
+   * thread which started the team may call them.
+   *
+   * The range is split into chunks of grainSize items, which the calling
+   * thread and the helpers take in turn until none are left, or with
+   * HELPER_SCHEDULE_STATIC each thread runs the chunks of its own equal part
+   * of the range. After a call,
+   * the helpers spin for a while waiting for the next one before sleeping,
+   * so that a call for each buffer does not pay for waking them up.
+   * Each call waits for all helpers to have seen it, so a sleeping helper
+   * delays the call by its wake-up time.
+   */
+  class HelperTeam : boost::noncopyable
+  {
+    unsigned int m_numHelpers;
+    boost::scoped_array<boost::thread> m_helpers;
+
+    Internal::HelperJob * m_job;
+    boost::atomic<unsigned int> m_generation;
+    /**
+     * @brief Helpers which have not finished the current job.
+     */
+    boost::atomic<unsigned int> m_numBusy;
+    boost::atomic<bool> m_isStopping;
+    bool m_isStarted;
+
+    Internal::Parker m_parker;
+
+    boost::uint64_t m_spinNsec;
+    HelperSchedule m_schedule;
+    bool m_pinHelpers;
+    bool m_isPinningFailed;
+
+    static boost::uint64_t now()
+    {
+      timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    static void relax()
+    {
+#if defined(__i386__) || defined(__x86_64__)
+      __builtin_ia32_pause();
+#endif
+    }
+
+    /**
+     * @brief Waits for a generation other than generation.
+     */
+    unsigned int waitForJob(unsigned int generation)
+    {
+      boost::uint64_t spinUntil = now() + m_spinNsec;
+      for (unsigned int i = 0;; ++i)
+      {
+        unsigned int current = m_generation.load(boost::memory_order_acquire);
+        if (current != generation)
+        {
+          return current;
+        }
+        if (i % 64 == 0 && now() >= spinUntil)
+        {
+          break;
+        }
+        relax();
+      }
+      for (;;)
+      {
+        unsigned int ticket = m_parker.prepare();
+        unsigned int current = m_generation.load(boost::memory_order_acquire);
+        if (current != generation)
+        {
+          return current;
+        }
+        m_parker.park(ticket);
+      }
+    }
+
+    void helperLoop(unsigned int thread, unsigned int generation)
+    {
+      for (;;)
+      {
+        generation = waitForJob(generation);
+        if (m_isStopping)
+        {
+          return;
+        }
+        try
+        {
+          m_job->run(thread);
+        }
+        catch (...)
+        {
+          m_job->fail();
+        }
+        m_numBusy.fetch_sub(1, boost::memory_order_release);
+      }
+    }
+
+    /**
+     * @brief Pins each helper to one of the CPUs the calling thread may run
+     * on, in turn from the one following the CPU it is running on.
+     *
+     * @return false if a helper could not be pinned.
+     */
+    bool pinHelpers()
+    {
+#ifdef __linux__
+      int readerCpu = sched_getcpu();
+      cpu_set_t allowed;
+      CPU_ZERO(&allowed);
+      if (readerCpu < 0
+          || sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+      {
+        return false;
+      }
+      std::vector<int> cpus;
+      size_t reader = 0;
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+      {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+          if (cpu == readerCpu)
+          {
+            reader = cpus.size();
+          }
+          cpus.push_back(cpu);
+        }
+      }
+      if (cpus.empty())
+      {
+        return false;
+      }
+      bool isPinned = true;
+      for (unsigned int i = 0; i < m_numHelpers; ++i)
+      {
+        cpu_set_t helperCpus;
+        CPU_ZERO(&helperCpus);
+        CPU_SET(cpus[(reader + 1 + i) % cpus.size()], &helperCpus);
+        if (pthread_setaffinity_np(m_helpers[i].native_handle(),
+              sizeof(helperCpus), &helperCpus) != 0)
+        {
+          isPinned = false;
+        }
+      }
+      return isPinned;
+#else
+      return false;
+#endif
+    }
+
+    /**
+     * @brief Runs job on the calling thread and the helpers.
+     */
+    void run(Internal::HelperJob & job)
+    {
+      if (!m_isStarted)
+      {
+        throw Exception("The helper team is not started.");
+      }
+      m_job = &job;
+      m_numBusy.store(m_numHelpers, boost::memory_order_relaxed);
+      m_generation.fetch_add(1, boost::memory_order_release);
+      m_parker.unpark();
+      try
+      {
+        job.run(0);
+      }
+      catch (...)
+      {
+        job.fail();
+        waitForHelpers();
+        throw;
+      }
+      waitForHelpers();
+      if (job.isFailed())
+      {
+        throw Exception("Exception in a helper thread.");
+      }
+    }
+
+    /**
+     * @brief Spins until the helpers are done, yielding after a while in
+     * case they are waiting for a core.
+     */
+    void waitForHelpers()
+    {
+      for (unsigned int i = 0; m_numBusy.load(boost::memory_order_acquire);
+          ++i)
+      {
+        if (i < 1024)
+        {
+          relax();
+        }
+        else
+        {
+          boost::this_thread::yield();
+        }
+      }
+    }
+
+    static size_t getGrainSize(
+        size_t size, unsigned int numThreads, size_t grainSize)
+    {
+      if (grainSize)
+      {
+        return grainSize;
+      }
+      grainSize = size / (numThreads * 8);
+      return grainSize ? grainSize : 1;
+    }
+
+    unsigned int getNumParts() const
+    {
+      return m_schedule == HELPER_SCHEDULE_STATIC ? getNumThreads() : 0;
+    }
+
+    public:
+      /**
+       * @param numHelpers
+       *  Number of helper threads, by default one per core besides the
+       *  reader.
+       */
+      HelperTeam(unsigned int numHelpers
+          = std::max(boost::thread::hardware_concurrency(), 1U) - 1)
+        : m_numHelpers(numHelpers),
+          m_job(0),
+          m_generation(0),
+          m_numBusy(0),
+          m_isStopping(false),
+          m_isStarted(false),
+          m_spinNsec(100000),
+          m_schedule(HELPER_SCHEDULE_DYNAMIC),
+          m_pinHelpers(false),
+          m_isPinningFailed(false)
+      {
+      }
+
+      /**
+       * @brief Sets how long helpers spin waiting for the next call before
+       * sleeping. Defaults to 100 usec.
+       */
+      void setSpinNsec(boost::uint64_t nsec)
+      {
+        m_spinNsec = nsec;
+      }
+
+      /**
+       * @brief Sets how the range of a call is split between the threads.
+       * Defaults to HELPER_SCHEDULE_DYNAMIC.
+       */
+      void setSchedule(HelperSchedule schedule)
+      {
+        m_schedule = schedule;
+      }
+
+      /**
+       * @brief Pins the helpers to the CPUs following the one start() is
+       * called on, out of those the calling thread may run on. If there are
+       * fewer such CPUs than threads, the helpers share them. Only on Linux.
+       */
+      void setPinHelpers(bool pinHelpers)
+      {
+        m_pinHelpers = pinHelpers;
+      }
+
+      /**
+       * @brief Returns true if pinning was asked for, but some helper could
+       * not be pinned by the last start().
+       */
+      bool isPinningFailed() const
+      {
+        return m_isPinningFailed;
+      }
+
+      /**
+       * @return Number of threads running a call, ie. the helpers and the
+       * calling thread.
+       */
+      unsigned int getNumThreads() const
+      {
+        return m_numHelpers + 1;
+      }
+
+      /**
+       * @brief Starts the helpers. Call from the thread that will use the
+       * team, eg. in initializeThread().
+       */
+      void start()
+      {
+        if (m_isStarted)
+        {
+          throw Exception("The helper team is already started.");
+        }
+        m_isStopping = false;
+        m_helpers.reset(new boost::thread[m_numHelpers]);
+        for (unsigned int i = 0; i < m_numHelpers; ++i)
+        {
+          m_helpers[i] = boost::thread(boost::bind(
+                &HelperTeam::helperLoop, this, i + 1,
+                m_generation.load()));
+        }
+        m_isPinningFailed = m_pinHelpers && !pinHelpers();
+        m_isStarted = true;
+      }
+
+      /**
+       * @brief Stops and joins the helpers, eg. in uninitializeThread().
+       */
+      void stop()
+      {
+        if (!m_isStarted)
+        {
+          return;
+        }
+        m_isStopping = true;
+        m_generation.fetch_add(1, boost::memory_order_release);
+        m_parker.unpark();
+        for (unsigned int i = 0; i < m_numHelpers; ++i)
+        {
+          m_helpers[i].join();
+        }
+        m_helpers.reset();
+        m_isStarted = false;
+      }
+
+      /**
+       * @brief Calls function(chunkBegin, chunkEnd) for chunks covering
+       * [begin, end), in parallel.
+       *
+       * @param grainSize
+       *  Number of items in a chunk, by default an eighth of the range per
+       *  thread.
+       */
+      template<typename _Iterator, typename _Function>
+      void parallelFor(_Iterator begin, _Iterator end, _Function function,
+          size_t grainSize = 0)
+      {
+        Internal::HelperForJob<_Iterator, _Function> job(begin, end,
+            getGrainSize(end - begin, getNumThreads(), grainSize),
+            getNumParts(), function);
+        run(job);
+      }
+
+      /**
+       * @brief Reduces [begin, end) in parallel.
+       *
+       * Each chunk is reduced with reduce(chunkBegin, chunkEnd), returning
+       * _T, and the results are combined with combine(_T, _T), starting from
+       * identity. combine must be associative and commutative, since the
+       * chunks are combined in no particular order.
+       */
+      template<
+        typename _Iterator,
+        typename _T,
+        typename _Reduce,
+        typename _Combine
+      >
+      _T parallelReduce(_Iterator begin, _Iterator end, const _T & identity,
+          _Reduce reduce, _Combine combine, size_t grainSize = 0)
+      {
+        Internal::HelperReduceJob<_Iterator, _T, _Reduce, _Combine> job(
+            begin, end, getGrainSize(end - begin, getNumThreads(), grainSize),
+            getNumThreads(), getNumParts(), identity, reduce, combine);
+        run(job);
+        return job.getResult();
+      }
+
+      ~HelperTeam()
+      {
+        stop();
+      }
+  };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/concept_check.hpp>
+#include <boost/mpl/has_xxx.hpp>
 
 namespace Rabotnik
 {
@@ -19,5 +20,26 @@ namespace Rabotnik
         q.finishReading();
       }
     };
+
+    BOOST_MPL_HAS_XXX_TRAIT_DEF(read_buffer)
+
+    /**
+     * @brief Type returned by beginReading() of a buffer queue: its
+     * read_buffer typedef if it has one, its buffer typedef otherwise.
+     */
+    template<
+      typename _BufferQueue,
+      bool _HasReadBuffer = has_read_buffer<_BufferQueue>::value
+    >
+    struct ReadBuffer
+    {
+      typedef typename _BufferQueue::buffer type;
+    };
+
+    template<typename _BufferQueue>
+    struct ReadBuffer<_BufferQueue, true>
+    {
+      typedef typename _BufferQueue::read_buffer type;
+    };
   }
 }
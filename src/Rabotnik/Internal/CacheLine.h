@@ -0,0 +1,38 @@
+#pragma once
+/**
+ * @file
+ * Contains helpers to keep frequently written values on separate cache lines.
+ */
+
+/**
+ * @brief Assumed size of a cache line, in bytes.
+ */
+#ifndef RABOTNIK_CACHE_LINE_SIZE
+#define RABOTNIK_CACHE_LINE_SIZE 64
+#endif
+
+namespace Rabotnik
+{
+  namespace Internal
+  {
+    /**
+     * @brief Value followed by a full cache line of padding, so that adjacent
+     * values written by different threads do not share a cache line.
+     */
+    template<typename _T>
+    struct CacheLinePadded
+    {
+      _T value;
+      char padding[RABOTNIK_CACHE_LINE_SIZE];
+
+      CacheLinePadded()
+      {
+      }
+
+      explicit CacheLinePadded(const _T & initialValue)
+        : value(initialValue)
+      {
+      }
+    };
+  }
+}
@@ -5,6 +5,7 @@
  */
 
 #include <Rabotnik/Internal/Utilities.h>
+#include <Rabotnik/Internal/PerfCounters.h>
 
 #include <boost/utility.hpp>
 #include <boost/date_time/posix_time/posix_time_types.hpp>
@@ -16,6 +17,7 @@ namespace Rabotnik
     HAS_MEMBER_FUNCTION(initializeThread);
     HAS_MEMBER_FUNCTION(uninitializeThread);
     HAS_MEMBER_FUNCTION(processBuffer);
+    HAS_MEMBER_FUNCTION(processIdle);
 
     template<typename _BufferHandler>
     typename boost::enable_if<
@@ -63,13 +65,60 @@ namespace Rabotnik
     {
     }
 
+    template<typename _BufferHandler>
+    typename boost::enable_if<
+      typename HasMemberFunction_processIdle<
+        _BufferHandler, 
+        void (_BufferHandler::*)()
+      >::type
+    >::type
+    callProcessIdle(_BufferHandler & bufferHandler)
+    {
+      bufferHandler.processIdle();
+    }
+
+    template<typename _BufferHandler>
+    typename boost::disable_if<
+      typename HasMemberFunction_processIdle<
+        _BufferHandler, 
+        void (_BufferHandler::*)()
+      >::type
+    >::type
+    callProcessIdle(_BufferHandler & bufferHandler)
+    {
+    }
+
+    /**
+     * @brief Performance counters measuring the processBuffer() calls.
+     */
+    class ProcessBufferCallerBase
+    {
+      protected:
+        PerfCounters m_perfCounters;
+
+      public:
+        PerfCounters & getPerfCounters()
+        {
+          return m_perfCounters;
+        }
+
+        const PerfCounters & getPerfCounters() const
+        {
+          return m_perfCounters;
+        }
+    };
+
     template<typename _BufferHandler, typename _Buffer, typename _Enabler = void>
-    class ProcessBufferCaller
+    class ProcessBufferCaller : public ProcessBufferCallerBase
     {
       public:
         void call(_BufferHandler & bufferHandler, _Buffer & buffer)
         {
+          //The handler may consume the buffer, so count the items first.
+          boost::uint64_t numItems = getNumItems(buffer);
+          m_perfCounters.begin();
           bufferHandler.processBuffer(buffer);
+          m_perfCounters.end(numItems);
         }
     };
 
@@ -84,7 +133,7 @@ namespace Rabotnik
           void (_BufferHandler::*)(_Buffer &, unsigned int)
         >::type
       >::type
-    >
+    > : public ProcessBufferCallerBase
     {
       boost::posix_time::ptime m_lastTick;
       public:
@@ -97,7 +146,10 @@ namespace Rabotnik
           {
             duration = currentTime - m_lastTick;
           }
+          boost::uint64_t numItems = getNumItems(buffer);
+          m_perfCounters.begin();
           bufferHandler.processBuffer(buffer, duration.total_microseconds());
+          m_perfCounters.end(numItems);
           m_lastTick = currentTime;
         }
     };
@@ -0,0 +1,145 @@
+#pragma once
+/**
+ * @file
+ * Contains a file descriptor signaling buffer queue readiness to event loops.
+ */
+
+#include <Rabotnik/Exception.h>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace Rabotnik
+{
+  namespace Internal
+  {
+    /**
+     * @brief File descriptor which becomes readable on signal() and stays
+     * readable until clear().
+     *
+     * Signals are coalesced: after the first signal(), further ones do not
+     * make a system call until clear(). Uses an eventfd on Linux and a pipe
+     * elsewhere. Closed until open() is called.
+     */
+    class EventFd : boost::noncopyable
+    {
+      int m_readFd;
+      int m_writeFd;
+      boost::atomic<bool> m_isSignaled;
+
+      public:
+        EventFd()
+          : m_readFd(-1),
+            m_writeFd(-1),
+            m_isSignaled(false)
+        {
+        }
+
+        /**
+         * @return Descriptor to poll for readability.
+         */
+        int open()
+        {
+          if (m_readFd >= 0)
+          {
+            return m_readFd;
+          }
+#ifdef __linux__
+          m_readFd = m_writeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+          if (m_readFd < 0)
+          {
+            throw Exception("Could not create eventfd.");
+          }
+#else
+          int fds[2];
+          if (pipe(fds) != 0)
+          {
+            throw Exception("Could not create pipe.");
+          }
+          for (int i = 0; i < 2; ++i)
+          {
+            fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+            fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+          }
+          m_readFd = fds[0];
+          m_writeFd = fds[1];
+#endif
+          return m_readFd;
+        }
+
+        bool isOpen() const
+        {
+          return m_readFd >= 0;
+        }
+
+        int getFd() const
+        {
+          return m_readFd;
+        }
+
+        /**
+         * @brief Makes the descriptor readable, if open.
+         */
+        void signal()
+        {
+          if (m_writeFd < 0 || m_isSignaled.load()
+              || m_isSignaled.exchange(true))
+          {
+            return;
+          }
+#ifdef __linux__
+          boost::uint64_t value = 1;
+#else
+          char value = 1;
+#endif
+          while (write(m_writeFd, &value, sizeof(value)) < 0 && errno == EINTR)
+          {
+          }
+        }
+
+        /**
+         * @brief Makes the descriptor unreadable until the next signal().
+         *
+         * Check for readiness after this, since signals before this are
+         * forgotten.
+         */
+        void clear()
+        {
+          if (m_readFd < 0)
+          {
+            return;
+          }
+          char data[64];
+          for (;;)
+          {
+            ssize_t n = read(m_readFd, data, sizeof(data));
+            if (n <= 0 && !(n < 0 && errno == EINTR))
+            {
+              break;
+            }
+          }
+          m_isSignaled.store(false);
+        }
+
+        ~EventFd()
+        {
+          if (m_readFd >= 0)
+          {
+            ::close(m_readFd);
+          }
+          if (m_writeFd >= 0 && m_writeFd != m_readFd)
+          {
+            ::close(m_writeFd);
+          }
+        }
+    };
+  }
+}
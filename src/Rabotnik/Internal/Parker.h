@@ -0,0 +1,63 @@
+#pragma once
+
+#include <boost/atomic.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace Rabotnik
+{
+  namespace Internal
+  {
+    /**
+     * @brief Lets a thread sleep until it is notified, without taking a lock
+     * when nobody is sleeping.
+     *
+     * Usage: take a ticket with prepare(), look for work, and if there was
+     * none, call park() with the ticket. Any unpark() after prepare() makes
+     * park() return immediately.
+     */
+    class Parker
+    {
+      boost::atomic<unsigned int> m_epoch;
+      boost::atomic<unsigned int> m_numSleepers;
+      boost::mutex m_mutex;
+      boost::condition_variable m_cond;
+
+      public:
+        Parker()
+          : m_epoch(0),
+            m_numSleepers(0)
+        {
+        }
+
+        unsigned int prepare() const
+        {
+          return m_epoch.load();
+        }
+
+        void park(unsigned int ticket)
+        {
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          ++m_numSleepers;
+          while (m_epoch.load() == ticket)
+          {
+            m_cond.wait(lock);
+          }
+          --m_numSleepers;
+        }
+
+        void unpark()
+        {
+          ++m_epoch;
+          if (m_numSleepers.load() != 0)
+          {
+            {
+              boost::unique_lock<boost::mutex> lock(m_mutex);
+            }
+            m_cond.notify_all();
+          }
+        }
+    };
+  }
+}
@@ -0,0 +1,230 @@
+#pragma once
+/**
+ * @file
+ * Contains hardware performance counters measuring buffer processing.
+ */
+
+#include <Rabotnik/PerfStats.h>
+#include <Rabotnik/Internal/Utilities.h>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+#include <boost/type_traits/is_class.hpp>
+#include <boost/type_traits/remove_const.hpp>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace Rabotnik
+{
+  namespace Internal
+  {
+    HAS_MEMBER_FUNCTION(length);
+
+    template<typename _Buffer, bool _IsClass = boost::is_class<_Buffer>::value>
+    struct HasLength : boost::false_type
+    {
+    };
+
+    template<typename _Buffer>
+    struct HasLength<_Buffer, true>
+      : HasMemberFunction_length<_Buffer, size_t (_Buffer::*)() const>::type
+    {
+    };
+
+    template<typename _Buffer>
+    typename boost::enable_if<
+      HasLength<typename boost::remove_const<_Buffer>::type>,
+      boost::uint64_t
+    >::type
+    getNumItems(_Buffer & buffer)
+    {
+      return buffer.length();
+    }
+
+    template<typename _Buffer>
+    typename boost::disable_if<
+      HasLength<typename boost::remove_const<_Buffer>::type>,
+      boost::uint64_t
+    >::type
+    getNumItems(_Buffer & /*buffer*/)
+    {
+      return 1;
+    }
+
+    /**
+     * @brief Group of hardware counters on the reader thread, read around
+     * each processed buffer.
+     *
+     * Disabled by default. When enabled, open() must be called on the thread
+     * to measure. If the counters cannot be opened, only buffers and items
+     * are counted.
+     */
+    class PerfCounters : boost::noncopyable
+    {
+      enum {
+        NUM_COUNTERS = 4,
+      };
+
+      bool m_isEnabled;
+      int m_fds[NUM_COUNTERS];
+      boost::uint64_t m_begin[NUM_COUNTERS];
+
+      boost::atomic<bool> m_isAvailable;
+      boost::atomic<boost::uint64_t> m_numBuffers;
+      boost::atomic<boost::uint64_t> m_numItems;
+      boost::atomic<boost::uint64_t> m_totals[NUM_COUNTERS];
+
+      /**
+       * @return False if the counters could not be read.
+       */
+      bool read(boost::uint64_t * values)
+      {
+#ifdef __linux__
+        boost::uint64_t data[1 + NUM_COUNTERS];
+        if (::read(m_fds[0], data, sizeof(data)) == sizeof(data)
+            && data[0] == NUM_COUNTERS)
+        {
+          memcpy(values, &data[1], sizeof(boost::uint64_t) * NUM_COUNTERS);
+          return true;
+        }
+#endif
+        return false;
+      }
+
+      public:
+        PerfCounters()
+          : m_isEnabled(false),
+            m_isAvailable(false)
+        {
+          for (int i = 0; i < NUM_COUNTERS; ++i)
+          {
+            m_fds[i] = -1;
+          }
+          resetStats();
+        }
+
+        void setEnabled(bool isEnabled)
+        {
+          m_isEnabled = isEnabled;
+        }
+
+        /**
+         * @brief Opens the counters for the calling thread, if enabled.
+         */
+        void open()
+        {
+          if (!m_isEnabled)
+          {
+            return;
+          }
+#ifdef __linux__
+          static const boost::uint64_t configs[NUM_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+          };
+          for (int i = 0; i < NUM_COUNTERS; ++i)
+          {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.disabled = i == 0;
+            m_fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1,
+                i == 0 ? -1 : m_fds[0], 0);
+            if (m_fds[i] < 0)
+            {
+              close();
+              return;
+            }
+          }
+          ioctl(m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+          m_isAvailable = true;
+#endif
+        }
+
+        void close()
+        {
+#ifdef __linux__
+          for (int i = NUM_COUNTERS - 1; i >= 0; --i)
+          {
+            if (m_fds[i] >= 0)
+            {
+              ::close(m_fds[i]);
+              m_fds[i] = -1;
+            }
+          }
+#endif
+          m_isAvailable = false;
+        }
+
+        void begin()
+        {
+          if (m_fds[0] >= 0 && !read(m_begin))
+          {
+            close();
+          }
+        }
+
+        void end(boost::uint64_t numItems)
+        {
+          if (!m_isEnabled)
+          {
+            return;
+          }
+          m_numBuffers.fetch_add(1, boost::memory_order_relaxed);
+          m_numItems.fetch_add(numItems, boost::memory_order_relaxed);
+
+          boost::uint64_t values[NUM_COUNTERS];
+          if (m_fds[0] >= 0 && read(values))
+          {
+            for (int i = 0; i < NUM_COUNTERS; ++i)
+            {
+              m_totals[i].fetch_add(
+                  values[i] - m_begin[i], boost::memory_order_relaxed);
+            }
+          }
+        }
+
+        PerfStats getStats() const
+        {
+          PerfStats stats;
+          stats.isAvailable = m_isAvailable;
+          stats.numBuffers = m_numBuffers;
+          stats.numItems = m_numItems;
+          stats.cycles = m_totals[0];
+          stats.instructions = m_totals[1];
+          stats.cacheMisses = m_totals[2];
+          stats.branchMisses = m_totals[3];
+          return stats;
+        }
+
+        void resetStats()
+        {
+          m_numBuffers = 0;
+          m_numItems = 0;
+          for (int i = 0; i < NUM_COUNTERS; ++i)
+          {
+            m_totals[i] = 0;
+          }
+        }
+
+        ~PerfCounters()
+        {
+          close();
+        }
+    };
+  }
+}
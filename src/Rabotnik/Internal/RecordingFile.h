@@ -0,0 +1,206 @@
+#pragma once
+/**
+ * @file
+ * Contains the file format of buffer recordings.
+ *
+ * A recording starts with an 8-byte magic and a 32-bit version, followed by
+ * records of a 64-bit timestamp in nanoseconds, a 32-bit size and the bytes
+ * of the buffer. Integers are in host byte order.
+ */
+
+#include <Rabotnik/Exception.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace Rabotnik
+{
+  namespace Internal
+  {
+    static const char RECORDING_MAGIC[8]
+      = { 'R', 'B', 'T', 'N', 'R', 'E', 'C', 0 };
+    static const boost::uint32_t RECORDING_VERSION = 1;
+
+    /**
+     * @brief Appends records to a recording. Thread-safe.
+     */
+    class RecordingFileWriter : boost::noncopyable
+    {
+      FILE * m_file;
+      std::vector<char> m_scratch;
+      boost::mutex m_mutex;
+
+      public:
+        RecordingFileWriter()
+          : m_file(0)
+        {
+        }
+
+        void open(const char * path)
+        {
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          if (m_file)
+          {
+            throw Exception("Recording already open.");
+          }
+          m_file = fopen(path, "wb");
+          if (!m_file
+              || fwrite(RECORDING_MAGIC, sizeof(RECORDING_MAGIC), 1, m_file)
+                != 1
+              || fwrite(&RECORDING_VERSION, sizeof(RECORDING_VERSION), 1,
+                m_file) != 1)
+          {
+            if (m_file)
+            {
+              fclose(m_file);
+              m_file = 0;
+            }
+            throw Exception("Could not open recording for writing.");
+          }
+        }
+
+        void close()
+        {
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          if (m_file)
+          {
+            fclose(m_file);
+            m_file = 0;
+          }
+        }
+
+        bool isOpen()
+        {
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          return m_file != 0;
+        }
+
+        /**
+         * @brief Writes a record, if the recording is open.
+         *
+         * Each record is flushed, so that when writing fails, eg. with the
+         * disk full, the partial record can be cut off. The recording is
+         * then closed and Exception is thrown. Records of 4 GiB or more do
+         * not fit the format and fail the same way.
+         *
+         * @param write Called with a pointer to size bytes to fill.
+         */
+        template<typename _Write>
+        void write(boost::uint64_t timestamp, size_t size, _Write write)
+        {
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          if (!m_file)
+          {
+            return;
+          }
+          m_scratch.resize(size);
+          if (size)
+          {
+            write(&m_scratch[0]);
+          }
+          boost::uint32_t size32 = size;
+          off_t start = ftello(m_file);
+          if (size32 != size
+              || fwrite(&timestamp, sizeof(timestamp), 1, m_file) != 1
+              || fwrite(&size32, sizeof(size32), 1, m_file) != 1
+              || (size && fwrite(&m_scratch[0], size, 1, m_file) != 1)
+              || fflush(m_file) != 0)
+          {
+            //Truncate after closing, since closing flushes what is left.
+            int fd = dup(fileno(m_file));
+            fclose(m_file);
+            m_file = 0;
+            if (fd >= 0)
+            {
+              while (start >= 0 && ftruncate(fd, start) != 0
+                  && errno == EINTR)
+              {
+              }
+              ::close(fd);
+            }
+            throw Exception("Could not write to recording.");
+          }
+        }
+
+        ~RecordingFileWriter()
+        {
+          close();
+        }
+    };
+
+    /**
+     * @brief Reads records from a recording.
+     */
+    class RecordingFileReader : boost::noncopyable
+    {
+      FILE * m_file;
+      std::vector<char> m_data;
+
+      public:
+        RecordingFileReader(const char * path)
+          : m_file(fopen(path, "rb"))
+        {
+          char magic[sizeof(RECORDING_MAGIC)];
+          boost::uint32_t version;
+          if (!m_file
+              || fread(magic, sizeof(magic), 1, m_file) != 1
+              || memcmp(magic, RECORDING_MAGIC, sizeof(magic))
+              || fread(&version, sizeof(version), 1, m_file) != 1
+              || version != RECORDING_VERSION)
+          {
+            if (m_file)
+            {
+              fclose(m_file);
+            }
+            throw Exception("Could not open recording for reading.");
+          }
+        }
+
+        /**
+         * @return False at the end of the recording.
+         */
+        bool read(boost::uint64_t & timestamp)
+        {
+          boost::uint32_t size;
+          if (fread(&timestamp, sizeof(timestamp), 1, m_file) != 1)
+          {
+            return false;
+          }
+          if (fread(&size, sizeof(size), 1, m_file) != 1)
+          {
+            throw Exception("Truncated recording.");
+          }
+          m_data.resize(size);
+          if (size && fread(&m_data[0], size, 1, m_file) != 1)
+          {
+            throw Exception("Truncated recording.");
+          }
+          return true;
+        }
+
+        const char * getData() const
+        {
+          return m_data.empty() ? 0 : &m_data[0];
+        }
+
+        size_t getSize() const
+        {
+          return m_data.size();
+        }
+
+        ~RecordingFileReader()
+        {
+          fclose(m_file);
+        }
+    };
+  }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Rabotnik/ReaderState.h>
+#include <Rabotnik/Trace.h>
 #include <boost/thread.hpp>
 
 namespace Rabotnik 
@@ -13,6 +14,17 @@ namespace Rabotnik
       mutable boost::mutex m_stateMutex;
       mutable boost::condition_variable m_stateCond;
 
+      static const char * getStateName(ReaderState state)
+      {
+        static const char * names[] = {
+          "READER_STATE_STOPPED",
+          "READER_STATE_STARTING",
+          "READER_STATE_RUNNING",
+          "READER_STATE_STOPPING",
+        };
+        return names[state];
+      }
+
       public:
         StateManager()
           : m_state(READER_STATE_STOPPED)
@@ -24,6 +36,7 @@ namespace Rabotnik
             boost::unique_lock<boost::mutex> lock(m_stateMutex);
             m_state = state;
           }
+          RABOTNIK_TRACE_INSTANT(getStateName(state));
           m_stateCond.notify_one();
         }
 
@@ -1,7 +1,17 @@
 #pragma once
 
+#include <boost/config.hpp>
 #include <boost/type_traits/integral_constant.hpp>
 
+/**
+ * @brief Defined when variadic templates and rvalue references are available,
+ * enabling in-place construction with perfect forwarding.
+ */
+#if !defined(BOOST_NO_CXX11_VARIADIC_TEMPLATES) \
+  && !defined(BOOST_NO_CXX11_RVALUE_REFERENCES)
+#define RABOTNIK_HAS_VARIADIC_FORWARDING
+#endif
+
 /**
  * @brief Makes a template<_T, _Sign> class HasMemberFunction_functionName.
  *
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/CoalescingWriter.h>
+#include <Rabotnik/Exception.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/utility.hpp>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Routes records into shards by key, so that records with the same
+   * key are handled in order by the same ReaderThread.
+   *
+   * Each shard is a ReaderThread with its own single-producer /
+   * single-consumer PushBufferQueue of StaticQueue buffers, filled through a
+   * CoalescingWriter. Keys are hashed into virtual buckets, and buckets are
+   * mapped to shards. rebalance() moves buckets from the busiest shards to
+   * the least busy ones at a point where all shards are idle, so the order
+   * within a key is kept.
+   *
+   * The dispatcher must only be used by one producer thread.
+   *
+   * @param _Record Type of the records.
+   * @param _KeyExtractor
+   *  Functor returning the key of a record, with a result_type typedef. The
+   *  key is hashed with boost::hash.
+   * @param _BufferHandler Type to handle the buffers of each shard, as in
+   *  ReaderThread. Each shard has its own default-constructed handler.
+   * @param _ShardCount Number of shards.
+   * @param _BatchSize Maximum number of records per buffer.
+   * @param _BuffersPerShard Number of buffers in the queue of each shard.
+   */
+  template<
+    typename _Record,
+    typename _KeyExtractor,
+    typename _BufferHandler,
+    unsigned int _ShardCount,
+    size_t _BatchSize = 64,
+    unsigned int _BuffersPerShard = 4
+  >
+  class KeyPartitionedDispatcher : boost::noncopyable
+  {
+    public:
+      typedef StaticQueue<_Record, _BatchSize> buffer;
+      typedef ReaderThread<
+        PushBufferQueue<buffer, _BuffersPerShard>,
+        _BufferHandler
+      > shard;
+
+    private:
+      typedef CoalescingWriter<buffer, shard> writer;
+      typedef typename _KeyExtractor::result_type key;
+
+      static const unsigned int m_numBuckets = _ShardCount * 64;
+
+      _KeyExtractor m_keyExtractor;
+      boost::hash<key> m_hash;
+
+      shard m_shards[_ShardCount];
+      boost::scoped_ptr<writer> m_writers[_ShardCount];
+
+      unsigned int m_bucketShards[m_numBuckets];
+      boost::uint64_t m_bucketLoads[m_numBuckets];
+
+      static unsigned int getBucket(boost::uint64_t hash)
+      {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return hash % m_numBuckets;
+      }
+
+      /**
+       * @brief Moves the heaviest bucket of the busiest shard to the least
+       * busy shard, if that lowers the load of the busiest shard.
+       *
+       * @return True if a bucket was moved.
+       */
+      bool moveBucket(boost::uint64_t * shardLoads)
+      {
+        unsigned int busiest = 0;
+        unsigned int idlest = 0;
+        for (unsigned int i = 1; i < _ShardCount; ++i)
+        {
+          if (shardLoads[i] > shardLoads[busiest])
+          {
+            busiest = i;
+          }
+          if (shardLoads[i] < shardLoads[idlest])
+          {
+            idlest = i;
+          }
+        }
+
+        unsigned int bucket = m_numBuckets;
+        for (unsigned int i = 0; i < m_numBuckets; ++i)
+        {
+          if (m_bucketShards[i] == busiest
+              && m_bucketLoads[i]
+                 < shardLoads[busiest] - shardLoads[idlest]
+              && (bucket == m_numBuckets
+                || m_bucketLoads[i] > m_bucketLoads[bucket]))
+          {
+            bucket = i;
+          }
+        }
+        if (bucket == m_numBuckets || !m_bucketLoads[bucket])
+        {
+          return false;
+        }
+
+        m_bucketShards[bucket] = idlest;
+        shardLoads[busiest] -= m_bucketLoads[bucket];
+        shardLoads[idlest] += m_bucketLoads[bucket];
+        return true;
+      }
+
+    public:
+      KeyPartitionedDispatcher(
+          const _KeyExtractor & keyExtractor = _KeyExtractor())
+        : m_keyExtractor(keyExtractor)
+      {
+        for (unsigned int i = 0; i < _ShardCount; ++i)
+        {
+          m_writers[i].reset(new writer(m_shards[i]));
+        }
+        for (unsigned int i = 0; i < m_numBuckets; ++i)
+        {
+          m_bucketShards[i] = i % _ShardCount;
+          m_bucketLoads[i] = 0;
+        }
+      }
+
+      /**
+       * @brief Sets the age of the oldest unpublished record after which a
+       * shard's buffer is published. See CoalescingWriter::setMaxLatency().
+       */
+      void setMaxLatency(boost::uint64_t nsec)
+      {
+        for (unsigned int i = 0; i < _ShardCount; ++i)
+        {
+          m_writers[i]->setMaxLatency(nsec);
+        }
+      }
+
+      void dispatch(const _Record & record)
+      {
+        unsigned int bucket = getBucket(m_hash(m_keyExtractor(record)));
+        ++m_bucketLoads[bucket];
+        m_writers[m_bucketShards[bucket]]->push_back(record);
+      }
+
+      /**
+       * @brief Publishes buffers whose time threshold has passed.
+       */
+      void poll()
+      {
+        for (unsigned int i = 0; i < _ShardCount; ++i)
+        {
+          m_writers[i]->poll();
+        }
+      }
+
+      /**
+       * @brief Publishes all partially filled buffers.
+       */
+      void flush()
+      {
+        for (unsigned int i = 0; i < _ShardCount; ++i)
+        {
+          m_writers[i]->flush();
+        }
+      }
+
+      /**
+       * @brief Flushes, waits until all shards have handled everything, and
+       * moves buckets from busy shards to idle ones based on the number of
+       * records dispatched since the last rebalance.
+       *
+       * @return Number of buckets moved.
+       */
+      unsigned int rebalance()
+      {
+        flush();
+        for (unsigned int i = 0; i < _ShardCount; ++i)
+        {
+          m_shards[i].getBufferQueue().waitForEmpty();
+        }
+
+        boost::uint64_t shardLoads[_ShardCount] = { 0 };
+        for (unsigned int i = 0; i < m_numBuckets; ++i)
+        {
+          shardLoads[m_bucketShards[i]] += m_bucketLoads[i];
+        }
+
+        unsigned int numMoved = 0;
+        while (numMoved < m_numBuckets && moveBucket(shardLoads))
+        {
+          ++numMoved;
+        }
+
+        for (unsigned int i = 0; i < m_numBuckets; ++i)
+        {
+          m_bucketLoads[i] = 0;
+        }
+        return numMoved;
+      }
+
+      shard & getShard(unsigned int index)
+      {
+        return m_shards[index];
+      }
+
+      void start()
+      {
+        for (unsigned int i = 0; i < _ShardCount; ++i)
+        {
+          m_shards[i].start();
+        }
+      }
+
+      /**
+       * @brief Flushes and stops all shards.
+       */
+      void stop()
+      {
+        flush();
+        for (unsigned int i = 0; i < _ShardCount; ++i)
+        {
+          m_shards[i].stop();
+        }
+      }
+
+      void join()
+      {
+        for (unsigned int i = 0; i < _ShardCount; ++i)
+        {
+          m_shards[i].join();
+        }
+      }
+  };
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Rabotnik/Exception.h>
+
+#include <boost/utility.hpp>
+#include <cstddef>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Buffer holding either an inline buffer for small messages, or a
+   * view of memory lent by the producer.
+   *
+   * Use as the buffer type of a buffer queue, eg.
+   * PushBufferQueue<LendableBuffer<StaticQueue<Message, 10> >, 3>, to pass
+   * large payloads, eg. DMA frames or mapped files, without copying them.
+   * The release function is called when the queue destroys the buffer, after
+   * the handler is done with the memory. It can eg. return the memory to a
+   * pool or decrement a reference count. Which thread calls it depends on
+   * the queue: PushBufferQueue and PullBufferQueue destroy buffers in
+   * finishReading() on the reader thread, but BroadcastBufferQueue destroys
+   * a buffer only when reusing it, in beginWriting() on the producer
+   * thread. Any queue destroys its remaining buffers in its destructor.
+   *
+   * @param _Buffer Type of the inline buffer.
+   */
+  template<typename _Buffer>
+  class LendableBuffer : boost::noncopyable
+  {
+    public:
+      /**
+       * @brief Called with the context, data and size given to lend().
+       */
+      typedef void (*release_function)(void * context, void * data,
+          size_t size);
+
+    private:
+      _Buffer m_buffer;
+
+      void * m_data;
+      size_t m_size;
+      release_function m_release;
+      void * m_context;
+
+    public:
+      LendableBuffer()
+        : m_data(0),
+          m_size(0),
+          m_release(0),
+          m_context(0)
+      {
+      }
+
+      /**
+       * @brief Constructs a buffer lending data, eg. with
+       * beginWriting(data, size, release, context).
+       */
+      LendableBuffer(void * data, size_t size, release_function release,
+          void * context)
+        : m_data(data),
+          m_size(size),
+          m_release(release),
+          m_context(context)
+      {
+      }
+
+      /**
+       * @brief Makes the buffer a view of data, until the buffer is
+       * destroyed.
+       *
+       * @param release
+       *  Called when the buffer is destroyed, possibly on another thread
+       *  than the reader. May be NULL.
+       */
+      void lend(void * data, size_t size, release_function release,
+          void * context)
+      {
+        if (m_data)
+        {
+          throw Exception("Buffer already lent.");
+        }
+        m_data = data;
+        m_size = size;
+        m_release = release;
+        m_context = context;
+      }
+
+      /**
+       * @return False if the inline buffer is used.
+       */
+      bool isLent() const
+      {
+        return m_data != 0;
+      }
+
+      void * getData() const { return m_data; }
+      size_t getSize() const { return m_size; }
+
+      _Buffer & getBuffer() { return m_buffer; }
+      const _Buffer & getBuffer() const { return m_buffer; }
+
+      ~LendableBuffer()
+      {
+        if (m_release)
+        {
+          m_release(m_context, m_data, m_size);
+        }
+      }
+  };
+}
@@ -0,0 +1,492 @@
+#pragma once
+
+#include <Rabotnik/Internal/Callers.h>
+#include <Rabotnik/Internal/Parker.h>
+#include <Rabotnik/Internal/StateManager.h>
+#include <Rabotnik/Exception.h>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/utility.hpp>
+#include <algorithm>
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+
+#include <boost/thread.hpp>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Thread merging several streams, each ordered by timestamp, into
+   * one sequence ordered by timestamp.
+   *
+   * Each stream has its own single-producer / single-consumer buffer queue.
+   * The heads of the streams are kept in a loser tree, and the handler is
+   * given runs of consecutive items of one stream, in place in the buffer.
+   * Since each stream is in timestamp order, the next item of an empty
+   * stream is no older than the last item it delivered. The thread thus
+   * waits only when an empty stream delivered an item older than the head
+   * of the winner, or none yet.
+   *
+   * With setMaxSkew(), an item is handed over without waiting for empty
+   * streams once some stream has written an item at least max skew newer.
+   * Items a stalled stream writes later may then be older than items
+   * already handed over. They are handed over as soon as possible and
+   * counted as late.
+   *
+   * @param _BufferQueue
+   *  Buffer queue having _Buffer * tryBeginReading(), eg. PushBufferQueue.
+   *  Its buffers must have begin() and end() with bidirectional
+   *  const_iterators over items in timestamp order, eg. StaticQueue.
+   *
+   * @param _TimestampExtractor
+   *  Functor returning the timestamp of an item, with a result_type typedef.
+   *  Timestamps are compared with operator<, and for the max skew,
+   *  subtracted.
+   *
+   * @param _BufferHandler
+   *  Type to handle the items. Must have void processRun(unsigned int stream,
+   *  const_iterator begin, const_iterator end). May have
+   *  void initializeThread() and/or void uninitializeThread().
+   *
+   * @param _NumStreams Number of streams.
+   */
+  template<
+    typename _BufferQueue,
+    typename _TimestampExtractor,
+    typename _BufferHandler,
+    unsigned int _NumStreams
+  >
+  class MergeReaderThread : boost::noncopyable
+  {
+    BOOST_STATIC_ASSERT(_NumStreams > 0);
+
+    public:
+      typedef typename _BufferQueue::buffer buffer;
+      typedef typename buffer::const_iterator const_iterator;
+      typedef typename _TimestampExtractor::result_type timestamp;
+
+    private:
+      struct Stream
+      {
+        _BufferQueue queue;
+
+        /**
+         * @brief Buffer being read, or NULL if the stream is empty.
+         */
+        const buffer * current;
+        const_iterator position;
+        const_iterator end;
+        timestamp head;
+
+        /**
+         * @brief Timestamp of the last item delivered, which the next item
+         * is not older than.
+         */
+        bool hasLowerBound;
+        timestamp lowerBound;
+
+        /**
+         * @brief Buffer being written. Used by the producer only.
+         */
+        buffer * writeBuffer;
+
+        Stream()
+          : current(0),
+            hasLowerBound(false),
+            lowerBound(),
+            writeBuffer(0)
+        {
+        }
+      };
+
+      /**
+       * @brief Up to where the winner may be handed over while streams are
+       * empty.
+       */
+      struct Limit
+      {
+        /**
+         * @brief Lowest lower bound of the empty streams, if they all have
+         * one.
+         */
+        bool hasEmptyBound;
+        timestamp emptyBound;
+        /**
+         * @brief Newest timestamp written, if there is a max skew.
+         */
+        bool isWatermarked;
+        timestamp latest;
+      };
+
+      Stream m_streams[_NumStreams];
+      unsigned int m_numEmptyStreams;
+
+      /**
+       * @brief Loser tree. Element 0 is the winner, elements 1 to
+       * _NumStreams - 1 are the losers of the inner nodes, and stream i is
+       * the leaf _NumStreams + i.
+       */
+      unsigned int m_tree[_NumStreams];
+
+      _TimestampExtractor m_timestampExtractor;
+      _BufferHandler m_handler;
+
+      boost::thread m_thread;
+      Internal::Parker m_parker;
+      Internal::StateManager m_stateManager;
+
+      bool m_hasMaxSkew;
+      timestamp m_maxSkew;
+
+      /**
+       * @brief Newest timestamp written to any stream.
+       */
+      bool m_hasLatestWritten;
+      timestamp m_latestWritten;
+      boost::mutex m_latestWrittenMutex;
+
+      bool m_hasLastHandled;
+      timestamp m_lastHandled;
+      boost::atomic<boost::uint64_t> m_numLateItems;
+
+      bool isLess(unsigned int a, unsigned int b) const
+      {
+        const Stream & sa = m_streams[a];
+        const Stream & sb = m_streams[b];
+        if (!sa.current || !sb.current)
+        {
+          return sa.current || (!sb.current && a < b);
+        }
+        if (sa.head < sb.head)
+        {
+          return true;
+        }
+        return !(sb.head < sa.head) && a < b;
+      }
+
+      unsigned int buildTree(unsigned int node)
+      {
+        if (node >= _NumStreams)
+        {
+          return node - _NumStreams;
+        }
+        unsigned int left = buildTree(2 * node);
+        unsigned int right = buildTree(2 * node + 1);
+        if (isLess(left, right))
+        {
+          m_tree[node] = right;
+          return left;
+        }
+        m_tree[node] = left;
+        return right;
+      }
+
+      /**
+       * @brief Updates the tree after the head of the winner changed.
+       */
+      void replay(unsigned int stream)
+      {
+        unsigned int winner = stream;
+        for (unsigned int node = (stream + _NumStreams) / 2; node; node /= 2)
+        {
+          if (isLess(m_tree[node], winner))
+          {
+            std::swap(m_tree[node], winner);
+          }
+        }
+        m_tree[0] = winner;
+      }
+
+      /**
+       * @brief Starts reading the next nonempty buffer of an empty stream.
+       *
+       * @return False if there was none.
+       */
+      bool refill(unsigned int stream)
+      {
+        Stream & s = m_streams[stream];
+        while (const buffer * b = s.queue.tryBeginReading())
+        {
+          if (b->begin() != b->end())
+          {
+            s.current = b;
+            s.position = b->begin();
+            s.end = b->end();
+            s.head = m_timestampExtractor(*s.position);
+            --m_numEmptyStreams;
+            return true;
+          }
+          s.queue.finishReading();
+        }
+        return false;
+      }
+
+      bool isPastWatermark(const timestamp & t, const timestamp & latest)
+      {
+        return t < latest && !(latest - t < m_maxSkew);
+      }
+
+      Limit getLimit()
+      {
+        Limit limit = { true, timestamp(), false, timestamp() };
+        bool isFirst = true;
+        for (unsigned int i = 0; i < _NumStreams; ++i)
+        {
+          const Stream & s = m_streams[i];
+          if (s.current)
+          {
+            continue;
+          }
+          if (!s.hasLowerBound)
+          {
+            limit.hasEmptyBound = false;
+            break;
+          }
+          if (isFirst || s.lowerBound < limit.emptyBound)
+          {
+            limit.emptyBound = s.lowerBound;
+            isFirst = false;
+          }
+        }
+        if (m_hasMaxSkew)
+        {
+          boost::unique_lock<boost::mutex> lock(m_latestWrittenMutex);
+          limit.isWatermarked = m_hasLatestWritten;
+          limit.latest = m_latestWritten;
+        }
+        return limit;
+      }
+
+      /**
+       * @return Whether no empty stream can still get an item older than t.
+       */
+      bool canHandOver(const timestamp & t, const Limit & limit)
+      {
+        return !m_numEmptyStreams
+          || (limit.hasEmptyBound && !(limit.emptyBound < t))
+          || (limit.isWatermarked && isPastWatermark(t, limit.latest));
+      }
+
+      void noteHandled(const timestamp & t)
+      {
+        if (m_hasLastHandled && t < m_lastHandled)
+        {
+          m_numLateItems.fetch_add(1, boost::memory_order_relaxed);
+          return;
+        }
+        m_hasLastHandled = true;
+        m_lastHandled = t;
+      }
+
+      /**
+       * @brief Hands over the longest run of the winner which does not pass
+       * the head of another stream or the limit.
+       */
+      void processRun(const Limit & limit)
+      {
+        unsigned int stream = m_tree[0];
+        Stream & s = m_streams[stream];
+        const_iterator begin = s.position;
+        for (;;)
+        {
+          noteHandled(s.head);
+          if (++s.position == s.end)
+          {
+            break;
+          }
+          s.head = m_timestampExtractor(*s.position);
+          replay(stream);
+          if (m_tree[0] != stream || !canHandOver(s.head, limit))
+          {
+            m_handler.processRun(stream, begin, s.position);
+            return;
+          }
+        }
+
+        m_handler.processRun(stream, begin, s.end);
+        s.hasLowerBound = true;
+        s.lowerBound = s.head;
+        s.current = 0;
+        ++m_numEmptyStreams;
+        s.queue.finishReading();
+        refill(stream);
+        replay(stream);
+      }
+
+      void threadLoop()
+      {
+        Internal::callInitializeThread(m_handler);
+        for (unsigned int i = 0; i < _NumStreams; ++i)
+        {
+          refill(i);
+        }
+        m_tree[0] = buildTree(1);
+        m_stateManager.setState(READER_STATE_RUNNING);
+
+        while (m_stateManager.getState() == READER_STATE_RUNNING)
+        {
+          unsigned int ticket = m_parker.prepare();
+          //Replaying only works for the winner, so rebuild the tree when
+          //other streams got a buffer.
+          bool isRefilled = false;
+          for (unsigned int i = 0; m_numEmptyStreams && i < _NumStreams; ++i)
+          {
+            if (!m_streams[i].current && refill(i))
+            {
+              isRefilled = true;
+            }
+          }
+          if (isRefilled)
+          {
+            m_tree[0] = buildTree(1);
+          }
+
+          const Stream & winner = m_streams[m_tree[0]];
+          Limit limit = { true, timestamp(), false, timestamp() };
+          if (winner.current && m_numEmptyStreams)
+          {
+            limit = getLimit();
+          }
+
+          if (!winner.current || !canHandOver(winner.head, limit))
+          {
+            m_parker.park(ticket);
+            continue;
+          }
+          processRun(limit);
+        }
+
+        Internal::callUninitializeThread(m_handler);
+        m_stateManager.setState(READER_STATE_STOPPED);
+      }
+
+    public:
+      MergeReaderThread()
+        : m_numEmptyStreams(_NumStreams),
+          m_hasMaxSkew(false),
+          m_maxSkew(),
+          m_hasLatestWritten(false),
+          m_latestWritten(),
+          m_hasLastHandled(false),
+          m_lastHandled(),
+          m_numLateItems(0)
+      {
+      }
+
+      /**
+       * @brief To be called by the producer of stream only.
+       */
+      buffer & beginWriting(unsigned int stream)
+      {
+        Stream & s = m_streams[stream];
+        s.writeBuffer = &s.queue.beginWriting();
+        return *s.writeBuffer;
+      }
+
+      void finishWriting(unsigned int stream)
+      {
+        Stream & s = m_streams[stream];
+        const buffer & b = *s.writeBuffer;
+        if (m_hasMaxSkew && b.begin() != b.end())
+        {
+          const_iterator last = b.end();
+          timestamp t = m_timestampExtractor(*--last);
+          boost::unique_lock<boost::mutex> lock(m_latestWrittenMutex);
+          if (!m_hasLatestWritten || m_latestWritten < t)
+          {
+            m_hasLatestWritten = true;
+            m_latestWritten = t;
+          }
+        }
+        s.queue.finishWriting();
+        m_parker.unpark();
+      }
+
+      /**
+       * @brief Lets items be handed over without waiting for empty streams
+       * once another stream has written an item maxSkew newer. Must be called
+       * before starting. The queue of a stream must be able to hold items
+       * spanning more than maxSkew, or the merge may wait for good.
+       */
+      void setMaxSkew(const timestamp & maxSkew)
+      {
+        m_hasMaxSkew = true;
+        m_maxSkew = maxSkew;
+      }
+
+      /**
+       * @brief Returns the number of items handed over after a newer item.
+       */
+      boost::uint64_t getNumLateItems() const
+      {
+        return m_numLateItems.load(boost::memory_order_relaxed);
+      }
+
+      _BufferHandler & getBufferHandler()
+      {
+        return m_handler;
+      }
+
+      const _BufferHandler & getBufferHandler() const
+      {
+        return m_handler;
+      }
+
+      _BufferQueue & getBufferQueue(unsigned int stream)
+      {
+        return m_streams[stream].queue;
+      }
+
+      void start()
+      {
+        if (m_stateManager.getState() != READER_STATE_STOPPED)
+        {
+          throw Exception("The thread is not stopped.");
+        }
+        m_stateManager.setState(READER_STATE_STARTING);
+        m_thread = boost::thread(
+            boost::bind(&MergeReaderThread::threadLoop, this));
+      }
+
+      void stop()
+      {
+        m_stateManager.setState(READER_STATE_STOPPING);
+        m_parker.unpark();
+      }
+
+      void join()
+      {
+        m_thread.join();
+      }
+
+      void waitForState(ReaderState state) const
+      {
+        m_stateManager.waitForState(state);
+      }
+
+      ~MergeReaderThread()
+      {
+        switch (m_stateManager.getState())
+        {
+          case READER_STATE_STARTING:
+            waitForState(READER_STATE_RUNNING);
+            stop();
+            join();
+            break;
+          case READER_STATE_RUNNING:
+            stop();
+            join();
+            break;
+          case READER_STATE_STOPPING:
+            join();
+            break;
+          default:
+            break;
+        }
+      }
+  };
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <Rabotnik/Internal/Utilities.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/utility.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/type_traits/type_with_alignment.hpp>
+#include <utility>
+#include <time.h>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Static-sized, single-producer / multi-consumer buffer queue.
+   *
+   * Each buffer is read by one of the consumers, which claim buffers in the
+   * order they were written but may finish them in any order. The writer
+   * takes any finished buffer, so a consumer slow on one buffer holds back
+   * only that buffer. Since several buffers are read at once,
+   * finishReading() takes the buffer, so this queue does not fit the buffer
+   * queue concept of ReaderThread. Read with ElasticReaderGroup.
+   *
+   * @param _Buffer Type of the buffer object.
+   * @param _BufferCount Number of buffers.
+   */
+  template<typename _Buffer, unsigned int _BufferCount>
+  class MultiConsumerBufferQueue : boost::noncopyable
+  {
+    enum SlotState {
+      SLOT_FREE,
+      SLOT_WRITING,
+      SLOT_FULL,
+      SLOT_READING,
+    };
+
+    /**
+     * @brief Storage of the buffers, aligned for _Buffer.
+     */
+    union
+    {
+      char m_buffers[_BufferCount * sizeof(_Buffer)];
+      typename boost::type_with_alignment<
+        boost::alignment_of<_Buffer>::value>::type m_alignment;
+    };
+    SlotState m_states[_BufferCount];
+    /**
+     * @brief Times of finishWriting() of full buffers.
+     */
+    boost::uint64_t m_writeTimes[_BufferCount];
+    /**
+     * @brief Stack of free buffers, the most recently finished on top.
+     */
+    unsigned int m_freeBuffers[_BufferCount];
+    /**
+     * @brief Ring of full buffers in the order they were written.
+     */
+    unsigned int m_fullBuffers[_BufferCount];
+
+    boost::mutex m_mutex;
+    boost::condition_variable m_readCond;
+    boost::condition_variable m_writeCond;
+
+    unsigned int m_currentReadBuffer;
+    unsigned int m_currentWriteBuffer;
+    unsigned int m_numFreeBuffers;
+    unsigned int m_numFullBuffers;
+    /**
+     * @brief Incremented by wakeReaders().
+     */
+    unsigned int m_wakeEpoch;
+
+    _Buffer * getBuffer(unsigned int index)
+    {
+      return reinterpret_cast<_Buffer*>(&m_buffers[index * sizeof(_Buffer)]);
+    }
+
+    static boost::uint64_t now()
+    {
+      timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    public:
+      typedef _Buffer buffer;
+
+      static const unsigned int bufferCount = _BufferCount;
+
+      MultiConsumerBufferQueue()
+        : m_currentReadBuffer(0),
+          m_currentWriteBuffer(0),
+          m_numFreeBuffers(_BufferCount),
+          m_numFullBuffers(0),
+          m_wakeEpoch(0)
+      {
+        for (unsigned int i = 0; i < _BufferCount; ++i)
+        {
+          m_states[i] = SLOT_FREE;
+          m_freeBuffers[i] = _BufferCount - 1 - i;
+        }
+      }
+
+      /**
+       * @brief Claims the oldest full buffer.
+       *
+       * @return NULL if there was no full buffer within timeout, or if
+       *  wakeReaders() was called while waiting.
+       */
+      _Buffer * beginReading(const boost::posix_time::time_duration & timeout)
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        unsigned int wakeEpoch = m_wakeEpoch;
+        boost::system_time deadline = boost::get_system_time() + timeout;
+        while (m_numFullBuffers == 0)
+        {
+          if (m_wakeEpoch != wakeEpoch
+              || !m_readCond.timed_wait(lock, deadline))
+          {
+            if (m_numFullBuffers == 0)
+            {
+              return 0;
+            }
+          }
+        }
+
+        unsigned int index = m_fullBuffers[m_currentReadBuffer];
+        if (++m_currentReadBuffer == _BufferCount)
+        {
+          m_currentReadBuffer = 0;
+        }
+        m_states[index] = SLOT_READING;
+        --m_numFullBuffers;
+        return getBuffer(index);
+      }
+
+      /**
+       * @param buffer Buffer returned by beginReading().
+       */
+      void finishReading(_Buffer & buffer)
+      {
+        buffer.~_Buffer();
+        unsigned int index = &buffer - getBuffer(0);
+        {
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          m_states[index] = SLOT_FREE;
+          m_freeBuffers[m_numFreeBuffers++] = index;
+        }
+        m_writeCond.notify_one();
+      }
+
+      /**
+       * @brief Makes all waiting beginReading() calls return.
+       */
+      void wakeReaders()
+      {
+        {
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          ++m_wakeEpoch;
+        }
+        m_readCond.notify_all();
+      }
+
+      /**
+       * @brief Returns the number of buffers written but not yet claimed.
+       */
+      unsigned int getNumFullBuffers()
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        return m_numFullBuffers;
+      }
+
+      /**
+       * @brief Returns nanoseconds since the oldest unclaimed buffer was
+       * written, or 0 if there is none.
+       */
+      boost::uint64_t getLagNsec()
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        if (m_numFullBuffers == 0)
+        {
+          return 0;
+        }
+        boost::uint64_t writeTime = m_writeTimes[m_fullBuffers[m_currentReadBuffer]];
+        boost::uint64_t currentTime = now();
+        return currentTime > writeTime ? currentTime - writeTime : 0;
+      }
+
+      /**
+       * @brief Waits for any finished buffer, not a particular one.
+       *
+       * @param args Passed to the buffer constructor, if supported.
+       */
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      template<typename... _Args>
+      _Buffer & beginWriting(_Args &&... args)
+#else
+      _Buffer & beginWriting()
+#endif
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        while (m_numFreeBuffers == 0)
+        {
+          m_writeCond.wait(lock);
+        }
+        m_currentWriteBuffer = m_freeBuffers[--m_numFreeBuffers];
+        m_states[m_currentWriteBuffer] = SLOT_WRITING;
+        lock.unlock();
+
+        _Buffer * buffer = getBuffer(m_currentWriteBuffer);
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+        new (buffer) _Buffer(std::forward<_Args>(args)...);
+#else
+        new (buffer) _Buffer();
+#endif
+        return *buffer;
+      }
+
+      void finishWriting()
+      {
+        boost::uint64_t writeTime = now();
+        {
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          m_states[m_currentWriteBuffer] = SLOT_FULL;
+          m_writeTimes[m_currentWriteBuffer] = writeTime;
+          unsigned int tail = m_currentReadBuffer + m_numFullBuffers;
+          if (tail >= _BufferCount)
+          {
+            tail -= _BufferCount;
+          }
+          m_fullBuffers[tail] = m_currentWriteBuffer;
+          ++m_numFullBuffers;
+        }
+        m_readCond.notify_one();
+      }
+
+      ~MultiConsumerBufferQueue()
+      {
+        for (unsigned int i = 0; i < _BufferCount; ++i)
+        {
+          if (m_states[i] != SLOT_FREE)
+          {
+            getBuffer(i)->~_Buffer();
+          }
+        }
+      }
+  };
+
+  template<typename _Buffer, unsigned int _BufferCount>
+  const unsigned int
+    MultiConsumerBufferQueue<_Buffer, _BufferCount>::bufferCount;
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <Rabotnik/Channel.h>
+#include <Rabotnik/Internal/Parker.h>
+#include <Rabotnik/Internal/StateManager.h>
+#include <Rabotnik/Exception.h>
+
+#include <boost/bind.hpp>
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+
+#include <boost/thread.hpp>
+#include <vector>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Describes how MultiplexReaderThread picks the next channel.
+   */
+  enum MultiplexPolicy {
+    /**
+     * @brief A channel is serviced only when all channels with a higher
+     * priority are empty.
+     */
+    MULTIPLEX_STRICT_PRIORITY,
+    /**
+     * @brief Channels are serviced in turns, each processing up to
+     * weight * batch limit buffers per turn.
+     */
+    MULTIPLEX_WEIGHTED_FAIR,
+  };
+
+  /**
+   * @brief Thread which handles buffers from several channels.
+   *
+   * Channels are owned by the user and must be added before the thread is
+   * started. Handler initialization and uninitialization are called on this
+   * thread, in the order the channels were added. The thread sleeps only when
+   * all channels are empty.
+   */
+  class MultiplexReaderThread
+    : public Internal::ChannelListener, boost::noncopyable
+  {
+    struct ChannelEntry
+    {
+      Internal::ChannelBase * channel;
+      unsigned int priority;
+      unsigned int weight;
+      unsigned int batchLimit;
+    };
+
+    boost::thread m_thread;
+
+    std::vector<ChannelEntry> m_channels;
+
+    MultiplexPolicy m_policy;
+
+    Internal::Parker m_parker;
+
+    Internal::StateManager m_stateManager;
+
+    /**
+     * @return True if any buffers were processed.
+     */
+    bool serviceStrictPriority()
+    {
+      for (size_t i = 0; i < m_channels.size(); ++i)
+      {
+        if (m_channels[i].channel->processBuffers(m_channels[i].batchLimit))
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /**
+     * @return True if any buffers were processed.
+     */
+    bool serviceWeightedFair()
+    {
+      bool processed = false;
+      for (size_t i = 0; i < m_channels.size(); ++i)
+      {
+        const ChannelEntry & entry = m_channels[i];
+        if (entry.channel->processBuffers(entry.weight * entry.batchLimit))
+        {
+          processed = true;
+        }
+      }
+      return processed;
+    }
+
+    void threadLoop()
+    {
+      for (size_t i = 0; i < m_channels.size(); ++i)
+      {
+        m_channels[i].channel->initializeThread();
+      }
+      m_stateManager.setState(READER_STATE_RUNNING);
+      while (m_stateManager.getState() == READER_STATE_RUNNING)
+      {
+        unsigned int ticket = m_parker.prepare();
+        bool processed = m_policy == MULTIPLEX_STRICT_PRIORITY
+          ? serviceStrictPriority()
+          : serviceWeightedFair();
+        if (!processed)
+        {
+          m_parker.park(ticket);
+        }
+      }
+      for (size_t i = 0; i < m_channels.size(); ++i)
+      {
+        m_channels[i].channel->uninitializeThread();
+      }
+      m_stateManager.setState(READER_STATE_STOPPED);
+    }
+
+    public:
+      MultiplexReaderThread(MultiplexPolicy policy = MULTIPLEX_STRICT_PRIORITY)
+        : m_policy(policy)
+      {
+      }
+
+      /**
+       * @param channel Channel to service. Not owned by the thread.
+       * @param priority
+       *  Channels with higher priority are serviced first. Among equal
+       *  priorities, channels added first are serviced first.
+       * @param weight Relative share with MULTIPLEX_WEIGHTED_FAIR.
+       * @param batchLimit Maximum number of buffers processed in one go.
+       */
+      void addChannel(
+          Internal::ChannelBase & channel,
+          unsigned int priority = 0,
+          unsigned int weight = 1,
+          unsigned int batchLimit = 1)
+      {
+        if (m_stateManager.getState() != READER_STATE_STOPPED)
+        {
+          throw Exception("The thread is not stopped.");
+        }
+        if (!weight || !batchLimit)
+        {
+          throw Exception("Weight and batch limit must be nonzero.");
+        }
+        ChannelEntry entry = { &channel, priority, weight, batchLimit };
+        std::vector<ChannelEntry>::iterator it = m_channels.begin();
+        while (it != m_channels.end() && it->priority >= priority)
+        {
+          ++it;
+        }
+        m_channels.insert(it, entry);
+        channel.setListener(this);
+      }
+
+      /**
+       * @brief Wakes up the thread, which polls all channels anyway.
+       */
+      void channelReady(Internal::ChannelBase & /*channel*/)
+      {
+        m_parker.unpark();
+      }
+
+      void start()
+      {
+        if (m_stateManager.getState() != READER_STATE_STOPPED)
+        {
+          throw Exception("The thread is not stopped.");
+        }
+        m_stateManager.setState(READER_STATE_STARTING);
+        m_thread = boost::thread(
+            boost::bind(&MultiplexReaderThread::threadLoop, this));
+      }
+
+      void stop()
+      {
+        m_stateManager.setState(READER_STATE_STOPPING);
+        m_parker.unpark();
+      }
+
+      void join()
+      {
+        m_thread.join();
+      }
+
+      void waitForState(ReaderState state) const
+      {
+        m_stateManager.waitForState(state);
+      }
+
+      ~MultiplexReaderThread()
+      {
+        switch (m_stateManager.getState())
+        {
+          case READER_STATE_STARTING:
+            waitForState(READER_STATE_RUNNING);
+            stop();
+            join();
+            break;
+          case READER_STATE_RUNNING:
+            stop();
+            join();
+            break;
+          case READER_STATE_STOPPING:
+            join();
+            break;
+          default:
+            break;
+        }
+        for (size_t i = 0; i < m_channels.size(); ++i)
+        {
+          m_channels[i].channel->setListener(0);
+        }
+      }
+  };
+}
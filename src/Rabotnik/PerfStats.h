@@ -0,0 +1,30 @@
+#pragma once
+
+#include <boost/cstdint.hpp>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Hardware performance counter totals for the buffers processed by
+   * a reader, in user space.
+   */
+  struct PerfStats
+  {
+    /**
+     * @brief False if the counters could not be opened, eg. because perf
+     * events are not supported or not permitted. The counter totals are zero
+     * then, but buffers and items are still counted.
+     */
+    bool isAvailable;
+    boost::uint64_t numBuffers;
+    /**
+     * @brief Number of items in the buffers, if the buffer has
+     * size_t length() const, otherwise the number of buffers.
+     */
+    boost::uint64_t numItems;
+    boost::uint64_t cycles;
+    boost::uint64_t instructions;
+    boost::uint64_t cacheMisses;
+    boost::uint64_t branchMisses;
+  };
+}
@@ -0,0 +1,356 @@
+#pragma once
+
+#include <Rabotnik/Internal/Callers.h>
+#include <Rabotnik/Internal/StateManager.h>
+#include <Rabotnik/Exception.h>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+
+#include <boost/thread.hpp>
+#include <errno.h>
+#include <time.h>
+#include <utility>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Timing statistics of a PeriodicReaderThread.
+   */
+  struct PeriodicStats
+  {
+    /**
+     * @brief Number of periods run.
+     */
+    boost::uint64_t numPeriods;
+    /**
+     * @brief Number of deadlines skipped because processing overran them.
+     */
+    boost::uint64_t numMissedDeadlines;
+    /**
+     * @brief Largest delay between a deadline and the wakeup.
+     */
+    boost::uint64_t maxJitterNsec;
+    /**
+     * @brief Sum of delays between deadlines and wakeups.
+     */
+    boost::uint64_t totalJitterNsec;
+  };
+
+  /**
+   * @brief Thread which wakes up on a fixed period and handles the buffers
+   * available at that time.
+   *
+   * Deadlines are absolute, so the period does not drift. When processing
+   * overruns one or more deadlines, they are counted as missed and the thread
+   * continues from the next deadline in the future.
+   *
+   * @param _BufferQueue
+   *  Buffer queue having _Buffer * tryBeginReading(), eg. PushBufferQueue.
+   *
+   * @param _BufferHandler
+   *  Type to handle the events, as in ReaderThread. May also have
+   *  void processIdle(), called on periods when no buffers were available.
+   */
+  template<
+    typename _BufferQueue,
+    typename _BufferHandler
+  >
+  class PeriodicReaderThread
+  {
+    public:
+      typedef typename _BufferQueue::buffer buffer;
+
+    private:
+    boost::thread m_thread;
+
+    _BufferQueue m_bufferQueue;
+
+    _BufferHandler m_handler;
+
+    Internal::StateManager m_stateManager;
+
+    Internal::ProcessBufferCaller<_BufferHandler, buffer> m_processBufferCaller;
+
+    boost::uint64_t m_periodNsec;
+    boost::uint64_t m_spinThresholdNsec;
+    unsigned int m_maxBuffersPerPeriod;
+
+    PeriodicStats m_stats;
+    mutable boost::mutex m_statsMutex;
+
+    static boost::uint64_t now()
+    {
+      timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    /**
+     * @brief Sleeps until spin threshold before the deadline, then spins.
+     */
+    void waitUntil(boost::uint64_t deadline)
+    {
+      if (deadline > m_spinThresholdNsec)
+      {
+        boost::uint64_t wakeup = deadline - m_spinThresholdNsec;
+        timespec ts;
+        ts.tv_sec = wakeup / 1000000000ULL;
+        ts.tv_nsec = wakeup % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) 
+            == EINTR)
+        {
+        }
+      }
+      while (now() < deadline)
+      {
+      }
+    }
+
+    /**
+     * @return Number of buffers processed.
+     */
+    unsigned int processBuffers()
+    {
+      unsigned int numProcessed = 0;
+      while (numProcessed < m_maxBuffersPerPeriod)
+      {
+        buffer * buffer = m_bufferQueue.tryBeginReading();
+        if (!buffer)
+        {
+          break;
+        }
+        m_processBufferCaller.call(m_handler, *buffer);
+        m_bufferQueue.finishReading();
+        ++numProcessed;
+      }
+      return numProcessed;
+    }
+
+    void threadLoop()
+    {
+      Internal::callInitializeThread(m_handler);
+      m_stateManager.setState(READER_STATE_RUNNING);
+      boost::uint64_t deadline = now();
+      while (m_stateManager.getState() == READER_STATE_RUNNING)
+      {
+        deadline += m_periodNsec;
+        waitUntil(deadline);
+        boost::uint64_t jitter = now() - deadline;
+
+        if (!processBuffers())
+        {
+          Internal::callProcessIdle(m_handler);
+        }
+
+        boost::uint64_t missed = 0;
+        boost::uint64_t finished = now();
+        if (finished >= deadline + m_periodNsec)
+        {
+          missed = (finished - deadline) / m_periodNsec;
+          deadline += missed * m_periodNsec;
+        }
+
+        boost::unique_lock<boost::mutex> lock(m_statsMutex);
+        ++m_stats.numPeriods;
+        m_stats.numMissedDeadlines += missed;
+        m_stats.totalJitterNsec += jitter;
+        if (jitter > m_stats.maxJitterNsec)
+        {
+          m_stats.maxJitterNsec = jitter;
+        }
+      }
+      Internal::callUninitializeThread(m_handler);
+      m_stateManager.setState(READER_STATE_STOPPED);
+    }
+
+    void initialize()
+    {
+      m_periodNsec = 1000000;
+      m_spinThresholdNsec = 0;
+      m_maxBuffersPerPeriod = ~0U;
+      resetStats();
+    }
+
+    public:
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      template<typename... _Args>
+      buffer & beginWriting(_Args &&... args)
+      {
+        return m_bufferQueue.beginWriting(std::forward<_Args>(args)...);
+      }
+#else
+      buffer & beginWriting() { return m_bufferQueue.beginWriting(); }
+#endif
+      void finishWriting() { m_bufferQueue.finishWriting(); }
+
+      /**
+       * @brief Sets the period. Must be called when the thread is stopped.
+       * Defaults to one millisecond.
+       */
+      void setPeriod(boost::uint64_t nsec)
+      {
+        if (!nsec)
+        {
+          throw Exception("Period must be nonzero.");
+        }
+        m_periodNsec = nsec;
+      }
+
+      /**
+       * @brief Sets how long before the deadline the thread stops sleeping
+       * and starts spinning. Zero (default) disables spinning.
+       */
+      void setSpinThreshold(boost::uint64_t nsec)
+      {
+        m_spinThresholdNsec = nsec;
+      }
+
+      /**
+       * @brief Limits the number of buffers processed per period, so that a
+       * burst does not make the thread miss deadlines. Unlimited by default.
+       */
+      void setMaxBuffersPerPeriod(unsigned int maxBuffers)
+      {
+        m_maxBuffersPerPeriod = maxBuffers;
+      }
+
+      PeriodicStats getStats() const
+      {
+        boost::unique_lock<boost::mutex> lock(m_statsMutex);
+        return m_stats;
+      }
+
+      void resetStats()
+      {
+        boost::unique_lock<boost::mutex> lock(m_statsMutex);
+        m_stats.numPeriods = 0;
+        m_stats.numMissedDeadlines = 0;
+        m_stats.maxJitterNsec = 0;
+        m_stats.totalJitterNsec = 0;
+      }
+
+      void start()
+      {
+        if (m_stateManager.getState() != READER_STATE_STOPPED)
+        {
+          throw Exception("The thread is not stopped.");
+        }
+        m_stateManager.setState(READER_STATE_STARTING);
+        m_thread = boost::thread(
+            boost::bind(&PeriodicReaderThread::threadLoop, this));
+      }
+
+      /**
+       * @brief Stops the thread at the end of the current period.
+       */
+      void stop()
+      {
+        m_stateManager.setState(READER_STATE_STOPPING);
+      }
+
+      void join()
+      {
+        m_thread.join();
+      }
+
+      _BufferHandler & getBufferHandler()
+      {
+        return m_handler;
+      }
+
+      const _BufferHandler & getBufferHandler() const
+      {
+        return m_handler;
+      }
+
+      _BufferQueue & getBufferQueue()
+      {
+        return m_bufferQueue;
+      }
+
+      const _BufferQueue & getBufferQueue() const
+      {
+        return m_bufferQueue;
+      }
+
+      void waitForState(ReaderState state) const
+      {
+        m_stateManager.waitForState(state);
+      }
+
+      PeriodicReaderThread()
+      {
+        initialize();
+      }
+
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      /**
+       * @param args Forwarded to the handler constructor.
+       */
+      template<typename... _Args>
+      PeriodicReaderThread(_Args &&... args)
+        : m_handler(std::forward<_Args>(args)...)
+      {
+        initialize();
+      }
+#else
+      /**
+       * @param arg1 Passed to the handler constructor.
+       */
+      template<typename _Arg1>
+      PeriodicReaderThread(_Arg1 arg1)
+        : m_handler(arg1)
+      {
+        initialize();
+      }
+
+      /**
+       * @param arg1 Passed to the handler constructor.
+       * @param arg2 Passed to the handler constructor.
+       */
+      template<typename _Arg1, typename _Arg2>
+      PeriodicReaderThread(_Arg1 arg1, _Arg2 arg2)
+        : m_handler(arg1, arg2)
+      {
+        initialize();
+      }
+
+      /**
+       * @param arg1 Passed to the handler constructor.
+       * @param arg2 Passed to the handler constructor.
+       * @param arg3 Passed to the handler constructor.
+       */
+      template<typename _Arg1, typename _Arg2, typename _Arg3>
+      PeriodicReaderThread(_Arg1 arg1, _Arg2 arg2, _Arg3 arg3)
+        : m_handler(arg1, arg2, arg3)
+      {
+        initialize();
+      }
+#endif
+
+      ~PeriodicReaderThread()
+      {
+        switch (m_stateManager.getState())
+        {
+          case READER_STATE_STARTING:
+            waitForState(READER_STATE_RUNNING);
+            stop();
+            join();
+            break;
+          case READER_STATE_RUNNING:
+            stop();
+            join();
+            break;
+          case READER_STATE_STOPPING:
+            join();
+            break;
+          default:
+            break;
+        }
+      }
+  };
+}
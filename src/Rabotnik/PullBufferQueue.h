@@ -2,10 +2,14 @@
 
 #include <Rabotnik/Exception.h>
 #include <Rabotnik/Internal/BufferQueue.h>
+#include <Rabotnik/Internal/EventFd.h>
+#include <Rabotnik/Trace.h>
 
 #include <boost/thread/locks.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/concept_check.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/type_traits/type_with_alignment.hpp>
 
 namespace Rabotnik
 {
@@ -21,17 +25,33 @@ namespace Rabotnik
   template<typename _Buffer>
   class PullBufferQueue
   {
-    char m_buffers[sizeof(_Buffer)*2];
+    /**
+     * @brief Storage of the buffers, aligned for _Buffer.
+     */
+    union
+    {
+      char m_buffers[sizeof(_Buffer)*2];
+      typename boost::type_with_alignment<
+        boost::alignment_of<_Buffer>::value>::type m_alignment;
+    };
 
     boost::recursive_mutex m_bufferMutex;
 
     unsigned int m_currentWriteBufferIndex;
 
+    /**
+     * @brief Whether the write buffer was written since the last swap.
+     */
+    bool m_isDirty;
+
+    Internal::EventFd m_eventFd;
+
     public:
       typedef _Buffer buffer;
 
       PullBufferQueue()
-        : m_currentWriteBufferIndex(0)
+        : m_currentWriteBufferIndex(0),
+          m_isDirty(false)
       {
         new (&m_buffers[0]) _Buffer();
         new (&m_buffers[sizeof(_Buffer)]) _Buffer();
@@ -50,9 +70,51 @@ namespace Rabotnik
       {
         boost::unique_lock<boost::recursive_mutex> lock(m_bufferMutex);
         m_currentWriteBufferIndex ^= sizeof(_Buffer);
+        m_isDirty = false;
+        RABOTNIK_TRACE_BEGIN("PullBufferQueue::read");
         return *(_Buffer*)&m_buffers[m_currentWriteBufferIndex ^ sizeof(_Buffer)];
       }
 
+      /**
+       * @brief Like beginReading(), but returns NULL instead of swapping when
+       * nothing was written since the last swap.
+       */
+      _Buffer * tryBeginReading()
+      {
+        boost::unique_lock<boost::recursive_mutex> lock(m_bufferMutex);
+        if (!m_isDirty)
+        {
+          return 0;
+        }
+        return &beginReading();
+      }
+
+      /**
+       * @brief Creates a descriptor which is readable while the write buffer
+       * may have been written since the last swap, for polling the queue from
+       * an event loop. Must be called before writing.
+       *
+       * A burst of finishWriting() calls makes a single wakeup. When the
+       * descriptor is readable, call clearEvent() and then tryBeginReading().
+       */
+      int enableEventFd()
+      {
+        return m_eventFd.open();
+      }
+
+      /**
+       * @return Descriptor created by enableEventFd(), or -1.
+       */
+      int getEventFd() const
+      {
+        return m_eventFd.getFd();
+      }
+
+      void clearEvent()
+      {
+        m_eventFd.clear();
+      }
+
       /**
        * @brief Recreates the buffer the application is done with.
        */
@@ -60,17 +122,22 @@ namespace Rabotnik
       {
         ((_Buffer&)m_buffers[m_currentWriteBufferIndex ^ sizeof(_Buffer)]).~_Buffer();
         new (&m_buffers[m_currentWriteBufferIndex ^ sizeof(_Buffer)]) _Buffer();
+        RABOTNIK_TRACE_END("PullBufferQueue::read");
       }
 
       _Buffer & beginWriting() 
       {
         m_bufferMutex.lock();
+        RABOTNIK_TRACE_BEGIN("PullBufferQueue::write");
         return *(_Buffer*)&m_buffers[m_currentWriteBufferIndex];
       }
 
       void finishWriting()
       {
+        RABOTNIK_TRACE_END("PullBufferQueue::write");
+        m_isDirty = true;
         m_bufferMutex.unlock();
+        m_eventFd.signal();
       }
 
       BOOST_CONCEPT_ASSERT((Internal::BufferQueueConceptCheck<PullBufferQueue<_Buffer> >));
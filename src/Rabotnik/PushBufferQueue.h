@@ -2,11 +2,18 @@
 
 #include <Rabotnik/Exception.h>
 #include <Rabotnik/Internal/BufferQueue.h>
+#include <Rabotnik/Internal/EventFd.h>
+#include <Rabotnik/Internal/Utilities.h>
+#include <Rabotnik/Trace.h>
 
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/concept_check.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/type_traits/type_with_alignment.hpp>
+
+#include <utility>
 
 namespace Rabotnik
 {
@@ -22,7 +29,15 @@ namespace Rabotnik
   {
     static const size_t m_maxBufferIndex = _BufferCount * sizeof(_Buffer);
 
-    char m_buffers[_BufferCount * sizeof(_Buffer)];
+    /**
+     * @brief Storage of the buffers, aligned for _Buffer.
+     */
+    union
+    {
+      char m_buffers[_BufferCount * sizeof(_Buffer)];
+      typename boost::type_with_alignment<
+        boost::alignment_of<_Buffer>::value>::type m_alignment;
+    };
 
     boost::condition_variable m_numFullBuffersCond;
     boost::mutex m_numFullBuffersMutex;
@@ -31,9 +46,17 @@ namespace Rabotnik
     unsigned int m_currentWriteBuffer;
     unsigned int m_numFullBuffers;
 
+    Internal::EventFd m_eventFd;
+
     public:
       typedef _Buffer buffer;
 
+      /**
+       * @brief Number of buffers, ie. the most buffers written but not yet
+       * read.
+       */
+      static const unsigned int bufferCount = _BufferCount;
+
       PushBufferQueue()
         : m_currentReadBuffer(0),
           m_currentWriteBuffer(0),
@@ -45,15 +68,35 @@ namespace Rabotnik
       {
         if (m_numFullBuffers == 0)
         {
+          RABOTNIK_TRACE_SCOPE("PushBufferQueue::park");
           boost::unique_lock<boost::mutex> lock(m_numFullBuffersMutex);
           while (m_numFullBuffers == 0)
           {
             m_numFullBuffersCond.wait(lock);
           }
         }
+        RABOTNIK_TRACE_BEGIN("PushBufferQueue::read");
         return *(_Buffer *)&m_buffers[m_currentReadBuffer];
       }
 
+      /**
+       * @brief Like beginReading(), but returns NULL instead of waiting when
+       * there are no full buffers.
+       */
+      _Buffer * tryBeginReading()
+      {
+        if (m_numFullBuffers == 0)
+        {
+          boost::unique_lock<boost::mutex> lock(m_numFullBuffersMutex);
+          if (m_numFullBuffers == 0)
+          {
+            return 0;
+          }
+        }
+        RABOTNIK_TRACE_BEGIN("PushBufferQueue::read");
+        return (_Buffer *)&m_buffers[m_currentReadBuffer];
+      }
+
       void finishReading()
       {
         ((_Buffer *)&m_buffers[m_currentReadBuffer])->~_Buffer();
@@ -70,22 +113,76 @@ namespace Rabotnik
         }
 
         m_numFullBuffersCond.notify_one();
+        RABOTNIK_TRACE_END("PushBufferQueue::read");
+      }
+
+      /**
+       * @brief Creates a descriptor which is readable while there may be full
+       * buffers, for polling the queue from an event loop. Must be called
+       * before writing.
+       *
+       * A burst of finishWriting() calls makes a single wakeup. When the
+       * descriptor is readable, call clearEvent() and then read buffers with
+       * tryBeginReading() until it returns NULL.
+       */
+      int enableEventFd()
+      {
+        return m_eventFd.open();
       }
 
-      _Buffer & beginWriting() 
+      /**
+       * @return Descriptor created by enableEventFd(), or -1.
+       */
+      int getEventFd() const
+      {
+        return m_eventFd.getFd();
+      }
+
+      void clearEvent()
+      {
+        m_eventFd.clear();
+      }
+
+      /**
+       * @brief Waits until the reader has finished reading all full buffers.
+       */
+      void waitForEmpty()
+      {
+        boost::unique_lock<boost::mutex> lock(m_numFullBuffersMutex);
+        while (m_numFullBuffers != 0)
+        {
+          m_numFullBuffersCond.wait(lock);
+        }
+      }
+
+      /**
+       * @param args Passed to the buffer constructor, if supported.
+       */
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      template<typename... _Args>
+      _Buffer & beginWriting(_Args &&... args)
+#else
+      _Buffer & beginWriting()
+#endif
       {
         if (m_numFullBuffers == _BufferCount)
         {
+          RABOTNIK_TRACE_SCOPE("PushBufferQueue::park");
           boost::unique_lock<boost::mutex> lock(m_numFullBuffersMutex);
           while (m_numFullBuffers == _BufferCount)
           {
             m_numFullBuffersCond.wait(lock);
           }
         }
+        RABOTNIK_TRACE_BEGIN("PushBufferQueue::write");
 
         _Buffer * buffer 
           = reinterpret_cast<_Buffer*>(&m_buffers[m_currentWriteBuffer]);
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+        new (buffer) _Buffer(std::forward<_Args>(args)...);
+#else
         new (buffer) _Buffer();
+#endif
         return *buffer;
       }
 
@@ -103,16 +200,28 @@ namespace Rabotnik
         }
 
         m_numFullBuffersCond.notify_one();
+        m_eventFd.signal();
+        RABOTNIK_TRACE_END("PushBufferQueue::write");
       }
 
       ~PushBufferQueue()
       {
-        for (int i = 0; i < m_numFullBuffers; ++i)
+        //Destroy the full buffers directly, since finishReading() would
+        //trace reads that never began.
+        for (unsigned int i = 0; i < m_numFullBuffers; ++i)
         {
-          finishReading();
+          ((_Buffer *)&m_buffers[m_currentReadBuffer])->~_Buffer();
+          m_currentReadBuffer += sizeof(_Buffer);
+          if (m_currentReadBuffer >= m_maxBufferIndex)
+          {
+            m_currentReadBuffer = 0;
+          }
         }
       }
 
       BOOST_CONCEPT_ASSERT((Internal::BufferQueueConceptCheck<PushBufferQueue<_Buffer, _BufferCount> >));
   };
+
+  template<typename _Buffer, unsigned int _BufferCount>
+  const unsigned int PushBufferQueue<_Buffer, _BufferCount>::bufferCount;
 }
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <Rabotnik/Internal/BufferQueue.h>
 #include <Rabotnik/Internal/Callers.h>
 #include <Rabotnik/Internal/StateManager.h>
 #include <Rabotnik/Exception.h>
+#include <Rabotnik/PerfStats.h>
 
 #include <boost/bind.hpp>
 //Hack to get around getpagesize() working on iOS SDK where it is deprecated
@@ -10,6 +12,7 @@
 extern "C" { int getpagesize(); }
 
 #include <boost/thread.hpp>
+#include <utility>
 
 namespace Rabotnik
 {
@@ -28,7 +31,11 @@ namespace Rabotnik
   >
   class ReaderThread
   {
-    typedef typename _BufferQueue::buffer buffer;
+    public:
+      typedef typename _BufferQueue::buffer buffer;
+
+    private:
+    typedef typename Internal::ReadBuffer<_BufferQueue>::type read_buffer;
     boost::thread m_thread;
 
     _BufferQueue m_bufferQueue;
@@ -37,17 +44,19 @@ namespace Rabotnik
 
     Internal::StateManager m_stateManager;
 
-    Internal::ProcessBufferCaller<_BufferHandler, buffer> m_processBufferCaller;
+    Internal::ProcessBufferCaller<_BufferHandler, read_buffer>
+      m_processBufferCaller;
 
     void threadLoop()
     {
       Internal::callInitializeThread(m_handler);
+      m_processBufferCaller.getPerfCounters().open();
       m_stateManager.setState(READER_STATE_RUNNING);
       while (m_stateManager.getState() == READER_STATE_RUNNING)
       {
         try 
         {
-          buffer & buffer = m_bufferQueue.beginReading();
+          read_buffer & buffer = m_bufferQueue.beginReading();
           {
             boost::this_thread::disable_interruption di;
             m_processBufferCaller.call(m_handler, buffer);
@@ -59,6 +68,7 @@ namespace Rabotnik
         }
 
       }
+      m_processBufferCaller.getPerfCounters().close();
       Internal::callUninitializeThread(m_handler);
       m_stateManager.setState(READER_STATE_STOPPED);
     }
@@ -79,7 +89,15 @@ namespace Rabotnik
     };
 
     public:
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      template<typename... _Args>
+      buffer & beginWriting(_Args &&... args)
+      {
+        return m_bufferQueue.beginWriting(std::forward<_Args>(args)...);
+      }
+#else
       buffer & beginWriting() { return m_bufferQueue.beginWriting(); }
+#endif
       void finishWriting() { m_bufferQueue.finishWriting(); }
 
       void start()
@@ -119,11 +137,40 @@ namespace Rabotnik
         return m_handler;
       }
 
+      _BufferQueue & getBufferQueue()
+      {
+        return m_bufferQueue;
+      }
+
+      const _BufferQueue & getBufferQueue() const
+      {
+        return m_bufferQueue;
+      }
+
       void waitForState(ReaderState state) const
       {
         m_stateManager.waitForState(state);
       }
 
+      /**
+       * @brief Enables or disables measuring processBuffer() with hardware
+       * performance counters. Takes effect when the thread is started.
+       */
+      void enablePerfCounters(bool isEnabled = true)
+      {
+        m_processBufferCaller.getPerfCounters().setEnabled(isEnabled);
+      }
+
+      PerfStats getPerfStats() const
+      {
+        return m_processBufferCaller.getPerfCounters().getStats();
+      }
+
+      void resetPerfStats()
+      {
+        m_processBufferCaller.getPerfCounters().resetStats();
+      }
+
       /**
        * @todo Enable this CTOR with template magic iff handler has default 
        * ctor.
@@ -132,6 +179,16 @@ namespace Rabotnik
       {
       }
 
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      /**
+       * @param args Forwarded to the handler constructor.
+       */
+      template<typename... _Args>
+      ReaderThread(_Args &&... args)
+        : m_handler(std::forward<_Args>(args)...)
+      {
+      }
+#else
       /**
        * @param arg1 Passed tot the handler constructor.
        */
@@ -173,6 +230,7 @@ namespace Rabotnik
         : m_handler(arg1, arg2, arg3, arg4)
       {
       }
+#endif
 
 
       ~ReaderThread() 
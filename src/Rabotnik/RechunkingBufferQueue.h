@@ -0,0 +1,261 @@
+#pragma once
+
+#include <Rabotnik/Internal/Utilities.h>
+
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#include <boost/utility.hpp>
+#include <cstddef>
+#include <utility>
+
+namespace Rabotnik
+{
+  template<typename _BufferQueue, unsigned int _FrameSize>
+  class RechunkingBufferQueue;
+
+  /**
+   * @brief Frame of items read from a RechunkingBufferQueue.
+   *
+   * Points into a written buffer when the frame lies within it, and holds a
+   * copy of the items otherwise.
+   */
+  template<typename _T, unsigned int _FrameSize>
+  class RechunkedFrame : boost::noncopyable
+  {
+    public:
+      typedef _T value_type;
+      typedef const _T * iterator;
+      typedef const _T * const_iterator;
+
+    private:
+      const _T * m_begin;
+
+      /**
+       * @brief Number of items copied into m_copy.
+       */
+      size_t m_numCopied;
+      typename boost::aligned_storage<
+        sizeof(_T) * _FrameSize, boost::alignment_of<_T>::value>::type m_copy;
+
+      _T * getCopy()
+      {
+        return static_cast<_T *>(static_cast<void *>(&m_copy));
+      }
+
+    public:
+      RechunkedFrame()
+        : m_begin(0),
+          m_numCopied(0)
+      {
+      }
+
+      const_iterator begin() const { return m_begin; }
+      const_iterator end() const { return m_begin + _FrameSize; }
+      size_t length() const { return _FrameSize; }
+
+      const _T & operator[](size_t i) const
+      {
+        return m_begin[i];
+      }
+
+      /**
+       * @return True if the frame straddled written buffers and was copied.
+       */
+      bool isCopied() const
+      {
+        return m_numCopied != 0;
+      }
+
+      ~RechunkedFrame()
+      {
+        clear();
+      }
+
+    private:
+      template<typename _BufferQueue, unsigned int _Size>
+      friend class RechunkingBufferQueue;
+
+      /**
+       * @brief Makes the frame point to _FrameSize items.
+       */
+      void view(const _T * begin)
+      {
+        m_begin = begin;
+      }
+
+      /**
+       * @brief Number of items still to be copied into the frame, or
+       * _FrameSize if none were.
+       */
+      size_t getNumLeft() const
+      {
+        return _FrameSize - m_numCopied;
+      }
+
+      /**
+       * @brief Appends copies of items to the frame.
+       */
+      void copy(const _T * begin, const _T * end)
+      {
+        _T * copy = getCopy();
+        m_begin = copy;
+        for (; begin != end; ++begin)
+        {
+          new (copy + m_numCopied) _T(*begin);
+          ++m_numCopied;
+        }
+      }
+
+      void clear()
+      {
+        _T * copy = getCopy();
+        while (m_numCopied)
+        {
+          copy[--m_numCopied].~_T();
+        }
+        m_begin = 0;
+      }
+  };
+
+  /**
+   * @brief Buffer queue wrapper reading frames of a fixed number of items,
+   * whatever the sizes of the written buffers.
+   *
+   * Use as the buffer queue of eg. a CallbackReader whose callback must
+   * handle exactly one period of items, eg.
+   * CallbackReader<RechunkingBufferQueue<PushBufferQueue<Q, 3>, 256>, ...>.
+   * The handler gets a read_buffer, ie. a RechunkedFrame. A frame within a
+   * written buffer points into it, and a frame straddling written buffers is
+   * copied. A written buffer is finished only when all its items are read,
+   * and the items left over when the reader stops are not read.
+   *
+   * beginReading() may wait for several written buffers, so only for
+   * push-style queues, where each finishWriting() makes one buffer
+   * available for reading.
+   *
+   * @param _BufferQueue
+   *  Buffer queue to wrap. Its buffers must store their items contiguously
+   *  and have value_type, begin() and length(), eg. StaticQueue.
+   *
+   * @param _FrameSize Number of items in each frame.
+   */
+  template<typename _BufferQueue, unsigned int _FrameSize>
+  class RechunkingBufferQueue : boost::noncopyable
+  {
+    BOOST_STATIC_ASSERT(_FrameSize > 0);
+
+    public:
+      typedef typename _BufferQueue::buffer buffer;
+      typedef typename buffer::value_type value_type;
+      typedef RechunkedFrame<value_type, _FrameSize> read_buffer;
+
+    private:
+      _BufferQueue m_bufferQueue;
+
+      /**
+       * @brief Written buffer being read, or NULL.
+       */
+      const buffer * m_current;
+      const value_type * m_position;
+      const value_type * m_end;
+
+      read_buffer m_frame;
+
+      /**
+       * @brief Starts reading the next nonempty written buffer.
+       */
+      void beginBuffer()
+      {
+        for (;;)
+        {
+          const buffer & b = m_bufferQueue.beginReading();
+          if (b.length())
+          {
+            m_current = &b;
+            m_position = &*b.begin();
+            m_end = m_position + b.length();
+            return;
+          }
+          m_bufferQueue.finishReading();
+        }
+      }
+
+      void finishBuffer()
+      {
+        m_current = 0;
+        m_bufferQueue.finishReading();
+      }
+
+    public:
+      RechunkingBufferQueue()
+        : m_current(0),
+          m_position(0),
+          m_end(0)
+      {
+      }
+
+      _BufferQueue & getBufferQueue() { return m_bufferQueue; }
+
+      /**
+       * @brief If waiting for a written buffer is interrupted while copying a
+       * frame, the next call resumes the frame.
+       */
+      read_buffer & beginReading()
+      {
+        if (!m_current)
+        {
+          beginBuffer();
+        }
+        size_t numLeft = m_frame.getNumLeft();
+        if (numLeft == _FrameSize && size_t(m_end - m_position) >= _FrameSize)
+        {
+          m_frame.view(m_position);
+          m_position += _FrameSize;
+          return m_frame;
+        }
+
+        for (;;)
+        {
+          size_t n = m_end - m_position;
+          if (n >= numLeft)
+          {
+            m_frame.copy(m_position, m_position + numLeft);
+            m_position += numLeft;
+            return m_frame;
+          }
+          m_frame.copy(m_position, m_end);
+          numLeft -= n;
+          finishBuffer();
+          beginBuffer();
+        }
+      }
+
+      void finishReading()
+      {
+        m_frame.clear();
+        if (m_current && m_position == m_end)
+        {
+          finishBuffer();
+        }
+      }
+
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      template<typename... _Args>
+      buffer & beginWriting(_Args &&... args)
+      {
+        return m_bufferQueue.beginWriting(std::forward<_Args>(args)...);
+      }
+#else
+      buffer & beginWriting()
+      {
+        return m_bufferQueue.beginWriting();
+      }
+#endif
+
+      void finishWriting()
+      {
+        m_bufferQueue.finishWriting();
+      }
+  };
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <Rabotnik/BufferSerializer.h>
+#include <Rabotnik/Exception.h>
+#include <Rabotnik/Internal/RecordingFile.h>
+#include <Rabotnik/Internal/Utilities.h>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/utility.hpp>
+#include <time.h>
+#include <utility>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Buffer queue wrapper recording each buffer read, along with the
+   * time it was finished writing, into a file that BufferReplayer can replay.
+   *
+   * Use as the buffer queue of a ReaderThread, eg.
+   * ReaderThread<RecordingBufferQueue<PushBufferQueue<Q, 3> >, Handler>.
+   * The recording is written on the reader thread, before the buffer is
+   * handled. If writing it fails, the recording is stopped and
+   * isRecordingFailed() returns true, but the buffers are read as usual.
+   * Only for push-style queues, where each finishWriting() makes one buffer
+   * available for reading.
+   *
+   * @param _BufferQueue
+   *  Buffer queue to wrap. Must have a bufferCount constant bounding the
+   *  number of buffers written but not yet read, eg. PushBufferQueue.
+   */
+  template<typename _BufferQueue>
+  class RecordingBufferQueue : boost::noncopyable
+  {
+    BOOST_STATIC_ASSERT(_BufferQueue::bufferCount > 0);
+
+    public:
+      typedef typename _BufferQueue::buffer buffer;
+
+    private:
+      struct SerializeBuffer
+      {
+        const buffer * m_buffer;
+
+        void operator()(char * out) const
+        {
+          BufferSerializer<buffer>::write(*m_buffer, out);
+        }
+      };
+
+      _BufferQueue m_bufferQueue;
+
+      /**
+       * @brief Mask of timestamp indices. The number of timestamps is a
+       * power of two at least bufferCount, so the ring cannot overflow.
+       */
+      static const unsigned int m_timestampMask
+        = (_BufferQueue::bufferCount - 1)
+          | ((_BufferQueue::bufferCount - 1) >> 1)
+          | ((_BufferQueue::bufferCount - 1) >> 2)
+          | ((_BufferQueue::bufferCount - 1) >> 4)
+          | ((_BufferQueue::bufferCount - 1) >> 8)
+          | ((_BufferQueue::bufferCount - 1) >> 16);
+
+      /**
+       * @brief Times of finishWriting(), oldest first.
+       */
+      boost::uint64_t m_timestamps[m_timestampMask + 1];
+      boost::atomic<unsigned int> m_timestampsHead;
+      boost::atomic<unsigned int> m_timestampsTail;
+
+      Internal::RecordingFileWriter m_recording;
+      boost::atomic<bool> m_isRecordingFailed;
+
+      static boost::uint64_t now()
+      {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+      }
+
+    public:
+      RecordingBufferQueue()
+        : m_timestampsHead(0),
+          m_timestampsTail(0),
+          m_isRecordingFailed(false)
+      {
+      }
+
+      /**
+       * @brief Starts recording the buffers read from now on into path.
+       */
+      void startRecording(const char * path)
+      {
+        m_isRecordingFailed = false;
+        m_recording.open(path);
+      }
+
+      void stopRecording()
+      {
+        m_recording.close();
+      }
+
+      /**
+       * @return True if writing the recording failed, which stopped it.
+       * Reset by startRecording().
+       */
+      bool isRecordingFailed() const
+      {
+        return m_isRecordingFailed;
+      }
+
+      _BufferQueue & getBufferQueue() { return m_bufferQueue; }
+
+      buffer & beginReading()
+      {
+        buffer & b = m_bufferQueue.beginReading();
+
+        unsigned int head = m_timestampsHead.load(boost::memory_order_relaxed);
+        boost::uint64_t timestamp = m_timestamps[head & m_timestampMask];
+        m_timestampsHead.store(head + 1, boost::memory_order_release);
+
+        SerializeBuffer serialize = { &b };
+        try
+        {
+          m_recording.write(
+              timestamp, BufferSerializer<buffer>::getSize(b), serialize);
+        }
+        catch (const Exception &)
+        {
+          m_isRecordingFailed = true;
+        }
+        return b;
+      }
+
+      void finishReading()
+      {
+        m_bufferQueue.finishReading();
+      }
+
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      template<typename... _Args>
+      buffer & beginWriting(_Args &&... args)
+      {
+        return m_bufferQueue.beginWriting(std::forward<_Args>(args)...);
+      }
+#else
+      buffer & beginWriting()
+      {
+        return m_bufferQueue.beginWriting();
+      }
+#endif
+
+      void finishWriting()
+      {
+        unsigned int tail = m_timestampsTail.load(boost::memory_order_relaxed);
+        m_timestamps[tail & m_timestampMask] = now();
+        m_timestampsTail.store(tail + 1, boost::memory_order_release);
+        m_bufferQueue.finishWriting();
+      }
+  };
+}
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <Rabotnik/Exception.h>
+#include <Rabotnik/Internal/BufferQueue.h>
+#include <Rabotnik/Internal/Utilities.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/type_traits/has_trivial_copy.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
+#include <boost/concept_check.hpp>
+#include <boost/utility.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/type_traits/type_with_alignment.hpp>
+
+#include <deque>
+#include <string>
+#include <cstdio>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace Rabotnik
+{
+  /**
+   * @brief PushBufferQueue which, instead of blocking the producer when all
+   * buffers are full, appends buffers to memory-mapped spill files.
+   *
+   * Spill files are fixed-size segments in a directory given to
+   * enableSpill(). Once a buffer has been spilled, later buffers are spilled
+   * too until the reader has caught up, so the reader sees the buffers in the
+   * order they were written. Spilled buffers are read in place from the
+   * mapping, and a segment is deleted as soon as it has been read.
+   *
+   * Without enableSpill(), behaves like PushBufferQueue.
+   *
+   * @param _Buffer Type of the buffer object. Must be trivially copyable and
+   *  destructible, since it is stored as raw bytes.
+   * @param _BufferCount Number of buffers in memory.
+   */
+  template<typename _Buffer, unsigned int _BufferCount>
+  class SpillingPushBufferQueue : boost::noncopyable
+  {
+    BOOST_STATIC_ASSERT(boost::has_trivial_copy<_Buffer>::value);
+    BOOST_STATIC_ASSERT(boost::has_trivial_destructor<_Buffer>::value);
+
+    struct Segment
+    {
+      std::string path;
+      int fd;
+      char * data;
+      size_t numWritten;
+      size_t numRead;
+    };
+
+    /**
+     * @brief Storage of the buffers, aligned for _Buffer.
+     */
+    union
+    {
+      char m_buffers[_BufferCount * sizeof(_Buffer)];
+      typename boost::type_with_alignment<
+        boost::alignment_of<_Buffer>::value>::type m_alignment;
+    };
+
+    boost::condition_variable m_cond;
+    boost::mutex m_mutex;
+
+    unsigned int m_currentReadBuffer;
+    unsigned int m_currentWriteBuffer;
+    unsigned int m_numFullBuffers;
+
+    std::string m_spillDirectory;
+    size_t m_buffersPerSegment;
+    unsigned int m_numSegmentsCreated;
+
+    /**
+     * @brief Segments, oldest first. Protected by m_mutex.
+     */
+    std::deque<Segment *> m_segments;
+    boost::uint64_t m_numSpilledBuffers;
+    boost::uint64_t m_totalSpilledBuffers;
+
+    bool m_isWritingSpill;
+    bool m_isReadingSpill;
+
+    _Buffer * getBuffer(unsigned int index)
+    {
+      return reinterpret_cast<_Buffer*>(&m_buffers[index * sizeof(_Buffer)]);
+    }
+
+    Segment * createSegment()
+    {
+      char name[64];
+      snprintf(name, sizeof(name), "/rabotnik-spill-%d-%p-%u.seg",
+          (int)getpid(), (void*)this, m_numSegmentsCreated++);
+
+      Segment * segment = new Segment();
+      segment->path = m_spillDirectory + name;
+      segment->numWritten = 0;
+      segment->numRead = 0;
+      segment->data = 0;
+      size_t size = m_buffersPerSegment * sizeof(_Buffer);
+
+      segment->fd = open(
+          segment->path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      //Reserve the space up front, so that running out of disk space is an
+      //exception here rather than SIGBUS when writing to the mapping.
+      if (segment->fd >= 0 && posix_fallocate(segment->fd, 0, size) == 0)
+      {
+        void * data = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+            segment->fd, 0);
+        if (data != MAP_FAILED)
+        {
+          segment->data = static_cast<char*>(data);
+          return segment;
+        }
+      }
+
+      destroySegment(segment);
+      throw Exception("Could not create a spill segment.");
+    }
+
+    void destroySegment(Segment * segment)
+    {
+      if (segment->data)
+      {
+        munmap(segment->data, m_buffersPerSegment * sizeof(_Buffer));
+      }
+      if (segment->fd >= 0)
+      {
+        close(segment->fd);
+        unlink(segment->path.c_str());
+      }
+      delete segment;
+    }
+
+    public:
+      typedef _Buffer buffer;
+
+      SpillingPushBufferQueue()
+        : m_currentReadBuffer(0),
+          m_currentWriteBuffer(0),
+          m_numFullBuffers(0),
+          m_buffersPerSegment(0),
+          m_numSegmentsCreated(0),
+          m_numSpilledBuffers(0),
+          m_totalSpilledBuffers(0),
+          m_isWritingSpill(false),
+          m_isReadingSpill(false)
+      {
+      }
+
+      /**
+       * @brief Enables spilling to files in directory. Must be called before
+       * writing.
+       *
+       * @param directory Existing, writable directory for the spill files.
+       * @param segmentSize Approximate size of each spill file in bytes.
+       */
+      void enableSpill(const std::string & directory, size_t segmentSize)
+      {
+        m_spillDirectory = directory;
+        m_buffersPerSegment = segmentSize / sizeof(_Buffer);
+        if (!m_buffersPerSegment)
+        {
+          m_buffersPerSegment = 1;
+        }
+      }
+
+      /**
+       * @brief Returns the number of spilled buffers not yet read.
+       */
+      boost::uint64_t getNumSpilledBuffers()
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        return m_numSpilledBuffers;
+      }
+
+      /**
+       * @brief Returns the number of buffers spilled since construction.
+       */
+      boost::uint64_t getTotalSpilledBuffers()
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        return m_totalSpilledBuffers;
+      }
+
+      _Buffer & beginReading()
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        while (m_numFullBuffers == 0 && m_numSpilledBuffers == 0)
+        {
+          m_cond.wait(lock);
+        }
+
+        m_isReadingSpill = m_numFullBuffers == 0;
+        if (!m_isReadingSpill)
+        {
+          return *getBuffer(m_currentReadBuffer);
+        }
+        Segment * segment = m_segments.front();
+        return *reinterpret_cast<_Buffer*>(
+            &segment->data[segment->numRead * sizeof(_Buffer)]);
+      }
+
+      void finishReading()
+      {
+        if (m_isReadingSpill)
+        {
+          Segment * finished = 0;
+          {
+            boost::unique_lock<boost::mutex> lock(m_mutex);
+            Segment * segment = m_segments.front();
+            ++segment->numRead;
+            --m_numSpilledBuffers;
+            if (segment->numRead == m_buffersPerSegment)
+            {
+              m_segments.pop_front();
+              finished = segment;
+            }
+          }
+          if (finished)
+          {
+            destroySegment(finished);
+          }
+          return;
+        }
+
+        if (++m_currentReadBuffer == _BufferCount)
+        {
+          m_currentReadBuffer = 0;
+        }
+
+        {
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          --m_numFullBuffers;
+        }
+
+        m_cond.notify_one();
+      }
+
+      /**
+       * @param args Passed to the buffer constructor, if supported.
+       */
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      template<typename... _Args>
+      _Buffer & beginWriting(_Args &&... args)
+#else
+      _Buffer & beginWriting()
+#endif
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        if (m_buffersPerSegment == 0)
+        {
+          while (m_numFullBuffers == _BufferCount)
+          {
+            m_cond.wait(lock);
+          }
+        }
+
+        m_isWritingSpill = m_numSpilledBuffers != 0
+          || m_numFullBuffers == _BufferCount;
+
+        _Buffer * buffer;
+        if (m_isWritingSpill)
+        {
+          if (m_segments.empty()
+              || m_segments.back()->numWritten == m_buffersPerSegment)
+          {
+            m_segments.push_back(createSegment());
+          }
+          Segment * segment = m_segments.back();
+          buffer = reinterpret_cast<_Buffer*>(
+              &segment->data[segment->numWritten * sizeof(_Buffer)]);
+        }
+        else
+        {
+          buffer = getBuffer(m_currentWriteBuffer);
+        }
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+        new (buffer) _Buffer(std::forward<_Args>(args)...);
+#else
+        new (buffer) _Buffer();
+#endif
+        return *buffer;
+      }
+
+      void finishWriting()
+      {
+        {
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          if (m_isWritingSpill)
+          {
+            ++m_segments.back()->numWritten;
+            ++m_numSpilledBuffers;
+            ++m_totalSpilledBuffers;
+          }
+          else
+          {
+            if (++m_currentWriteBuffer == _BufferCount)
+            {
+              m_currentWriteBuffer = 0;
+            }
+            ++m_numFullBuffers;
+          }
+        }
+
+        m_cond.notify_one();
+      }
+
+      ~SpillingPushBufferQueue()
+      {
+        while (!m_segments.empty())
+        {
+          destroySegment(m_segments.front());
+          m_segments.pop_front();
+        }
+      }
+
+      BOOST_CONCEPT_ASSERT((Internal::BufferQueueConceptCheck<SpillingPushBufferQueue<_Buffer, _BufferCount> >));
+  };
+}
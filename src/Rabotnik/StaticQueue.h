@@ -1,9 +1,11 @@
 #pragma once
 
 #include <Rabotnik/Exception.h>
+#include <Rabotnik/Internal/Utilities.h>
 
 #include <boost/utility.hpp>
 #include <iostream>
+#include <utility>
 
 namespace Rabotnik
 {
@@ -22,6 +24,17 @@ namespace Rabotnik
     size_t m_sizeLeft;
 #endif
     public:
+#ifndef RABOTNIK_UNCHECKED
+      StaticQueueWriter()
+        : m_writePointer(0),
+          m_sizeLeft(0)
+#else
+      StaticQueueWriter()
+        : m_writePointer(0)
+#endif
+      {
+      }
+
 #ifndef RABOTNIK_UNCHECKED
       StaticQueueWriter(_T * firstWritePointer, size_t sizeLeft)
         : m_writePointer(firstWritePointer),
@@ -56,6 +69,37 @@ namespace Rabotnik
         new (m_writePointer++) _T(value);
       }
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+      void push_back(_T && value)
+      {
+#ifndef RABOTNIK_UNCHECKED
+        if (!m_sizeLeft--)
+        {
+          throw Exception("Overflow in _T & StaticQueueWriter::push_back().");
+        }
+#endif
+        new (m_writePointer++) _T(std::move(value));
+      }
+#endif
+
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      /**
+       * @brief Constructs the item in place from args.
+       */
+      template<typename... _Args>
+      _T & emplace_back(_Args &&... args)
+      {
+#ifndef RABOTNIK_UNCHECKED
+        if (!m_sizeLeft--)
+        {
+          throw Exception(
+              "Overflow in _T & StaticQueueWriter::emplace_back().");
+        }
+#endif
+        return *new (m_writePointer++) _T(std::forward<_Args>(args)...);
+      }
+#endif
+
       _T * const getWritePointer() const { return m_writePointer; }
   };
 
@@ -69,9 +113,12 @@ namespace Rabotnik
     _T * m_writePointer;
 
     public:
+      typedef _T value_type;
       typedef _T * iterator;
       typedef const _T * const_iterator;
 
+      static const size_t capacity = _NumItems;
+
       StaticQueue()
         : m_writePointer(reinterpret_cast<_T*>(&m_queue[0]))
       {
@@ -113,6 +160,41 @@ namespace Rabotnik
         new (m_writePointer++) _T(item);
       }
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+      /**
+       * @brief Invalidates iterators. Moves item into the queue.
+       */
+      void push_back(_T && item)
+      {
+#ifndef RABOTNIK_UNCHECKED
+        if (m_writePointer 
+            >= reinterpret_cast<_T*>(&m_queue[_NumItems * sizeof(_T)]))
+        {
+          throw Exception("Overflow in void StaticQueue::push_back(_T &&).");
+        }
+#endif
+        new (m_writePointer++) _T(std::move(item));
+      }
+#endif
+
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      /**
+       * @brief Invalidates iterators. Constructs the item in place from args.
+       */
+      template<typename... _Args>
+      _T & emplace_back(_Args &&... args)
+      {
+#ifndef RABOTNIK_UNCHECKED
+        if (m_writePointer 
+            >= reinterpret_cast<_T*>(&m_queue[_NumItems * sizeof(_T)]))
+        {
+          throw Exception("Overflow in _T & StaticQueue::emplace_back().");
+        }
+#endif
+        return *new (m_writePointer++) _T(std::forward<_Args>(args)...);
+      }
+#endif
+
       /**
        * @brief Invalidates iterators. Marks the item returned as complete, so
        * if you are using this, you cannot be reading at the same time.
@@ -176,5 +258,8 @@ namespace Rabotnik
         clear();
       }
   };
+
+  template<typename _T, size_t _NumItems>
+  const size_t StaticQueue<_T, _NumItems>::capacity;
 }
 
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <Rabotnik/Exception.h>
+#include <Rabotnik/Internal/CacheLine.h>
+
+#include <boost/config.hpp>
+#include <boost/utility.hpp>
+
+#if defined(BOOST_NO_CXX11_VARIADIC_TEMPLATES) \
+  || defined(BOOST_NO_CXX11_ALIGNAS)
+#error "StaticSoAQueue requires C++11."
+#endif
+
+#include <tuple>
+
+namespace Rabotnik
+{
+  namespace Internal
+  {
+    template<size_t... _I>
+    struct IndexSequence
+    {
+    };
+
+    template<size_t _N, size_t... _I>
+    struct MakeIndexSequence : MakeIndexSequence<_N - 1, _N - 1, _I...>
+    {
+    };
+
+    template<size_t... _I>
+    struct MakeIndexSequence<0, _I...>
+    {
+      typedef IndexSequence<_I...> type;
+    };
+
+    /**
+     * @brief Uninitialized storage for one column, starting on a cache line.
+     */
+    template<typename _T, size_t _NumItems>
+    struct SoAColumn
+    {
+      alignas(RABOTNIK_CACHE_LINE_SIZE) char data[_NumItems * sizeof(_T)];
+
+      /**
+       * @brief Leaves the storage uninitialized.
+       */
+      SoAColumn()
+      {
+      }
+
+      _T * get()
+      {
+        return reinterpret_cast<_T*>(data);
+      }
+
+      const _T * get() const
+      {
+        return reinterpret_cast<const _T*>(data);
+      }
+    };
+  }
+
+  /**
+   * @brief Contiguous items of one field of a StaticSoAQueue.
+   *
+   * The first item is aligned to RABOTNIK_CACHE_LINE_SIZE.
+   */
+  template<typename _T>
+  class StaticSoAColumn
+  {
+    _T * m_begin;
+    size_t m_length;
+
+    public:
+      typedef _T value_type;
+      typedef _T * iterator;
+
+      StaticSoAColumn(_T * begin, size_t length)
+        : m_begin(begin),
+          m_length(length)
+      {
+      }
+
+      _T * data() const { return m_begin; }
+      iterator begin() const { return m_begin; }
+      iterator end() const { return m_begin + m_length; }
+      size_t length() const { return m_length; }
+
+      _T & operator[](size_t index) const
+      {
+        return m_begin[index];
+      }
+  };
+
+  /**
+   * @brief Proxy reference to one row of a StaticSoAQueue.
+   *
+   * @param _Queue StaticSoAQueue, const for read-only rows.
+   */
+  template<typename _Queue>
+  class StaticSoARow
+  {
+    _Queue * m_queue;
+    size_t m_index;
+
+    public:
+      StaticSoARow(_Queue & queue, size_t index)
+        : m_queue(&queue),
+          m_index(index)
+      {
+      }
+
+      template<size_t _I>
+      auto get() const -> decltype(m_queue->template getColumnData<_I>()[0])
+      {
+        return m_queue->template getColumnData<_I>()[m_index];
+      }
+  };
+
+  /**
+   * @brief Writer for writing multiple rows into a StaticSoAQueue fast, like
+   * StaticQueueWriter. The rows become part of the queue at
+   * StaticSoAQueue::finishWriting().
+   */
+  template<typename _Queue>
+  class StaticSoAQueueWriter
+  {
+    _Queue * m_queue;
+    size_t m_length;
+
+    void checkOverflow()
+    {
+#ifndef RABOTNIK_UNCHECKED
+      if (m_length >= _Queue::capacity)
+      {
+        throw Exception("Overflow in StaticSoAQueueWriter::push_back().");
+      }
+#endif
+    }
+
+    public:
+      StaticSoAQueueWriter()
+        : m_queue(0),
+          m_length(0)
+      {
+      }
+
+      StaticSoAQueueWriter(_Queue & queue, size_t length)
+        : m_queue(&queue),
+          m_length(length)
+      {
+      }
+
+      StaticSoARow<_Queue> push_back()
+      {
+        checkOverflow();
+        m_queue->constructRow(m_length);
+        return StaticSoARow<_Queue>(*m_queue, m_length++);
+      }
+
+      template<typename... _Values>
+      void push_back(const _Values &... values)
+      {
+        checkOverflow();
+        m_queue->constructRow(m_length++, values...);
+      }
+
+      size_t getLength() const { return m_length; }
+  };
+
+  /**
+   * @brief Statically allocated queue of rows of fields, stored as one
+   * contiguous, cache line aligned array per field (struct of arrays).
+   *
+   * Counterpart of StaticQueue for handlers touching only a few fields of
+   * each row, eg. for vectorized loops over column<I>(). Can be used as the
+   * buffer type of the buffer queues. Requires C++11.
+   *
+   * @param _NumItems Maximum number of rows.
+   * @param _Fields Types of the fields of a row.
+   */
+  template<size_t _NumItems, typename... _Fields>
+  class StaticSoAQueue : boost::noncopyable
+  {
+    template<typename _Queue> friend class StaticSoARow;
+    template<typename _Queue> friend class StaticSoAQueueWriter;
+
+    typedef typename Internal::MakeIndexSequence<sizeof...(_Fields)>::type
+      indices;
+
+    std::tuple<Internal::SoAColumn<_Fields, _NumItems>...> m_columns;
+    size_t m_length;
+
+    template<size_t _I>
+    auto getColumnData() -> decltype(std::get<_I>(m_columns).get())
+    {
+      return std::get<_I>(m_columns).get();
+    }
+
+    template<size_t _I>
+    auto getColumnData() const -> decltype(std::get<_I>(m_columns).get())
+    {
+      return std::get<_I>(m_columns).get();
+    }
+
+    template<typename _T>
+    static void destroy(_T * item)
+    {
+      item->~_T();
+    }
+
+    template<size_t... _I>
+    void constructFields(size_t index, Internal::IndexSequence<_I...>)
+    {
+      int expand[] = {
+        0, (new (getColumnData<_I>() + index) _Fields(), 0)...
+      };
+      (void)expand;
+    }
+
+    template<size_t... _I, typename... _Values>
+    void constructFields(size_t index, Internal::IndexSequence<_I...>,
+        const _Values &... values)
+    {
+      int expand[] = {
+        0, (new (getColumnData<_I>() + index) _Fields(values), 0)...
+      };
+      (void)expand;
+    }
+
+    template<size_t... _I>
+    void destroyFields(size_t index, Internal::IndexSequence<_I...>)
+    {
+      int expand[] = { 0, (destroy(getColumnData<_I>() + index), 0)... };
+      (void)expand;
+    }
+
+    void constructRow(size_t index)
+    {
+      constructFields(index, indices());
+    }
+
+    template<typename... _Values>
+    void constructRow(size_t index, const _Values &... values)
+    {
+      static_assert(sizeof...(_Values) == sizeof...(_Fields),
+          "One value per field is required.");
+      constructFields(index, indices(), values...);
+    }
+
+    void checkOverflow() const
+    {
+#ifndef RABOTNIK_UNCHECKED
+      if (m_length >= _NumItems)
+      {
+        throw Exception("Overflow in StaticSoAQueue::push_back().");
+      }
+#endif
+    }
+
+    public:
+      template<size_t _I>
+      struct field
+      {
+        typedef typename std::tuple_element<_I, std::tuple<_Fields...> >::type
+          type;
+      };
+
+      typedef StaticSoARow<StaticSoAQueue> row_reference;
+      typedef StaticSoARow<const StaticSoAQueue> const_row_reference;
+
+      static const size_t capacity = _NumItems;
+
+      StaticSoAQueue()
+        : m_length(0)
+      {
+      }
+
+      template<size_t _I>
+      StaticSoAColumn<typename field<_I>::type> column()
+      {
+        return StaticSoAColumn<typename field<_I>::type>(
+            getColumnData<_I>(), m_length);
+      }
+
+      template<size_t _I>
+      StaticSoAColumn<const typename field<_I>::type> column() const
+      {
+        return StaticSoAColumn<const typename field<_I>::type>(
+            getColumnData<_I>(), m_length);
+      }
+
+      row_reference operator[](size_t index)
+      {
+        return row_reference(*this, index);
+      }
+
+      const_row_reference operator[](size_t index) const
+      {
+        return const_row_reference(*this, index);
+      }
+
+      /**
+       * @brief Appends a row of values, one per field.
+       */
+      void push_back(const _Fields &... values)
+      {
+        checkOverflow();
+        constructRow(m_length, values...);
+        ++m_length;
+      }
+
+      /**
+       * @brief Appends a row of default constructed fields.
+       */
+      row_reference push_back()
+      {
+        checkOverflow();
+        constructRow(m_length);
+        return row_reference(*this, m_length++);
+      }
+
+      size_t length() const
+      {
+        return m_length;
+      }
+
+      void clear()
+      {
+        while (m_length)
+        {
+          destroyFields(--m_length, indices());
+        }
+      }
+
+      /**
+       * @addtogroup Writing with a writer
+       * @{
+       */
+
+      typedef StaticSoAQueueWriter<StaticSoAQueue> writer;
+
+      writer beginWriting()
+      {
+        return writer(*this, m_length);
+      }
+
+      void finishWriting(const writer & w)
+      {
+        m_length = w.getLength();
+      }
+
+      /** @} */
+
+      ~StaticSoAQueue()
+      {
+        clear();
+      }
+  };
+
+  template<size_t _NumItems, typename... _Fields>
+  const size_t StaticSoAQueue<_NumItems, _Fields...>::capacity;
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <Rabotnik/Exception.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/Internal/Utilities.h>
+
+#include <boost/atomic.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#include <boost/utility.hpp>
+#include <utility>
+
+namespace Rabotnik
+{
+  /**
+   * @brief Reader resuming from where it last was in a StreamingStaticQueue.
+   *
+   * Usage:
+   * \code
+   *  Queue::reader r(q);
+   *  while (...)
+   *  {
+   *    r.update();
+   *    for (Queue::const_iterator i = r.begin(); i != r.end(); ++i) ...
+   *  }
+   */
+  template<typename _Queue>
+  class StreamingStaticQueueReader
+  {
+    public:
+      typedef typename _Queue::const_iterator const_iterator;
+
+    private:
+      const _Queue * m_queue;
+      const_iterator m_begin;
+      const_iterator m_end;
+
+    public:
+      StreamingStaticQueueReader(const _Queue & queue)
+        : m_queue(&queue),
+          m_begin(queue.begin()),
+          m_end(m_begin)
+      {
+      }
+
+      /**
+       * @brief Moves past the items read, to the items published since.
+       *
+       * @return False if there were none.
+       */
+      bool update()
+      {
+        m_begin = m_end;
+        m_end = m_queue->end();
+        return m_begin != m_end;
+      }
+
+      /**
+       * @brief Starts again from the first item, eg. after the queue was
+       * cleared.
+       */
+      void rewind()
+      {
+        m_begin = m_end = m_queue->begin();
+      }
+
+      const_iterator begin() const { return m_begin; }
+      const_iterator end() const { return m_end; }
+  };
+
+  /**
+   * @brief Statically allocated queue with one writer and any number of
+   * readers, which see each item as soon as it is published.
+   *
+   * push_back(), emplace_back(), publish() and finishWriting() publish the
+   * items written so far with a release store, and readers iterate the
+   * published items [begin(), end()) without locking. Use a reader to
+   * iterate only the items published since the last time.
+   *
+   * Published items are never changed or moved until clear(), which the
+   * writer may only call when no reader is reading.
+   */
+  template<typename _T, size_t _NumItems>
+  class StreamingStaticQueue : boost::noncopyable
+  {
+    typename boost::aligned_storage<
+      _NumItems * sizeof(_T), boost::alignment_of<_T>::value>::type m_queue;
+
+    /**
+     * @brief Used by the writer only.
+     */
+    _T * m_writePointer;
+    boost::atomic<const _T *> m_publishedEnd;
+
+    _T * getBegin()
+    {
+      return static_cast<_T *>(static_cast<void *>(&m_queue));
+    }
+
+    void checkOverflow(const char * message)
+    {
+#ifndef RABOTNIK_UNCHECKED
+      if (m_writePointer >= getBegin() + _NumItems)
+      {
+        throw Exception(message);
+      }
+#endif
+    }
+
+    public:
+      typedef _T value_type;
+      typedef const _T * iterator;
+      typedef const _T * const_iterator;
+
+      static const size_t capacity = _NumItems;
+
+      typedef StreamingStaticQueueReader<StreamingStaticQueue> reader;
+
+      StreamingStaticQueue()
+        : m_writePointer(getBegin()),
+          m_publishedEnd(getBegin())
+      {
+      }
+
+      const_iterator begin() const
+      {
+        return static_cast<const _T *>(static_cast<const void *>(&m_queue));
+      }
+
+      /**
+       * @brief Returns the end of the items published so far.
+       */
+      const_iterator end() const
+      {
+        return m_publishedEnd.load(boost::memory_order_acquire);
+      }
+
+      size_t length() const
+      {
+        return end() - begin();
+      }
+
+      /**
+       * @brief Publishes all items written, eg. after push_back().
+       */
+      void publish()
+      {
+        m_publishedEnd.store(m_writePointer, boost::memory_order_release);
+      }
+
+      void push_back(const _T & item)
+      {
+        checkOverflow(
+            "Overflow in void StreamingStaticQueue::push_back(const _T &).");
+        new (m_writePointer++) _T(item);
+        publish();
+      }
+
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+      void push_back(_T && item)
+      {
+        checkOverflow(
+            "Overflow in void StreamingStaticQueue::push_back(_T &&).");
+        new (m_writePointer++) _T(std::move(item));
+        publish();
+      }
+#endif
+
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      /**
+       * @brief Constructs and publishes a new item. As with StaticQueue, the
+       * item is returned mutable, but readers may be reading it already.
+       */
+      template<typename... _Args>
+      _T & emplace_back(_Args &&... args)
+      {
+        checkOverflow("Overflow in _T & StreamingStaticQueue::emplace_back().");
+        _T * item = new (m_writePointer++) _T(std::forward<_Args>(args)...);
+        publish();
+        return *item;
+      }
+#endif
+
+      /**
+       * @brief Returns a new item, which is not published until publish() or
+       * the next push_back().
+       */
+      _T & push_back()
+      {
+        checkOverflow("Overflow in _T & StreamingStaticQueue::push_back().");
+        return *new (m_writePointer++) _T();
+      }
+
+      /**
+       * @brief Destroys all items. No reader may be reading.
+       */
+      void clear()
+      {
+        m_publishedEnd.store(getBegin(), boost::memory_order_relaxed);
+        while (m_writePointer != getBegin())
+        {
+          (--m_writePointer)->~_T();
+        }
+      }
+
+      /**
+       * @addtogroup Writing with a writer
+       * @{
+       */
+
+      typedef StaticQueueWriter<_T> writer;
+
+      /**
+       * @brief Items written with the writer are published together in
+       * finishWriting().
+       */
+      writer beginWriting()
+      {
+#ifndef RABOTNIK_UNCHECKED
+        return writer(m_writePointer, _NumItems - (m_writePointer - getBegin()));
+#else
+        return writer(m_writePointer);
+#endif
+      }
+
+      void finishWriting(const writer w)
+      {
+        m_writePointer = w.getWritePointer();
+        publish();
+      }
+
+      /** @} */
+
+      ~StreamingStaticQueue()
+      {
+        clear();
+      }
+  };
+
+  template<typename _T, size_t _NumItems>
+  const size_t StreamingStaticQueue<_T, _NumItems>::capacity;
+}
@@ -0,0 +1,353 @@
+#pragma once
+/**
+ * @file
+ * Contains optional event tracing, exportable as Chrome trace event JSON
+ * (chrome://tracing, Perfetto).
+ *
+ * Tracing is compiled in only when RABOTNIK_TRACE is defined. Otherwise the
+ * trace macros expand to nothing, and their arguments are not evaluated.
+ *
+ * Each thread records events into its own ring buffer of
+ * RABOTNIK_TRACE_RING_SIZE events, overwriting the oldest events when full.
+ * The ring of a thread is kept after it exits, so that its events can be
+ * dumped, until a new thread reuses it.
+ */
+
+#ifdef RABOTNIK_TRACE
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/utility.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <ios>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief Number of events in the ring buffer of each thread. Must be a power
+ * of two.
+ */
+#ifndef RABOTNIK_TRACE_RING_SIZE
+#define RABOTNIK_TRACE_RING_SIZE 65536
+#endif
+
+#define RABOTNIK_TRACE_BEGIN(name) \
+  ::Rabotnik::Trace::record(::Rabotnik::Trace::EVENT_BEGIN, name)
+#define RABOTNIK_TRACE_END(name) \
+  ::Rabotnik::Trace::record(::Rabotnik::Trace::EVENT_END, name)
+#define RABOTNIK_TRACE_INSTANT(name) \
+  ::Rabotnik::Trace::record(::Rabotnik::Trace::EVENT_INSTANT, name)
+/**
+ * @brief Records a begin event, and the matching end event when the
+ * enclosing scope is left, also by an exception.
+ */
+#define RABOTNIK_TRACE_SCOPE(name) \
+  ::Rabotnik::Trace::Scope rabotnikTraceScope(name)
+
+namespace Rabotnik
+{
+  namespace Trace
+  {
+    enum EventType {
+      EVENT_BEGIN,
+      EVENT_END,
+      EVENT_INSTANT,
+    };
+
+    namespace Internal
+    {
+      struct Event
+      {
+        boost::uint64_t ticks;
+        /**
+         * @brief Must point to a string with static storage duration.
+         */
+        const char * name;
+        EventType type;
+      };
+
+      struct Ring : boost::noncopyable
+      {
+        Event events[RABOTNIK_TRACE_RING_SIZE];
+        boost::atomic<boost::uint64_t> head;
+        long threadId;
+
+        Ring()
+          : head(0)
+        {
+        }
+      };
+
+      inline boost::uint64_t getNsec()
+      {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+      }
+
+      inline boost::uint64_t getTicks()
+      {
+#if defined(__i386__) || defined(__x86_64__)
+        return __rdtsc();
+#else
+        return getNsec();
+#endif
+      }
+
+      inline void releaseRing(Ring * ring);
+
+      struct Registry
+      {
+        boost::mutex mutex;
+        std::vector<Ring *> rings;
+        /**
+         * @brief Rings of exited threads, reused by new threads.
+         */
+        std::vector<Ring *> freeRings;
+        boost::uint64_t startTicks;
+        boost::uint64_t startNsec;
+        std::string exitPath;
+        /**
+         * @brief Releases the ring of a thread when it exits.
+         */
+        boost::thread_specific_ptr<Ring> threadRing;
+
+        Registry()
+          : startTicks(getTicks()),
+            startNsec(getNsec()),
+            threadRing(&releaseRing)
+        {
+        }
+
+        ~Registry()
+        {
+          //Do not release the ring of the exiting main thread into the
+          //registry being destroyed.
+          threadRing.release();
+        }
+      };
+
+      inline Registry & getRegistry()
+      {
+        static Registry registry;
+        return registry;
+      }
+
+      inline Ring *& getThreadRing()
+      {
+        static __thread Ring * ring = 0;
+        return ring;
+      }
+
+      inline Ring * registerThread()
+      {
+        Registry & registry = getRegistry();
+        Ring * ring;
+        {
+          boost::unique_lock<boost::mutex> lock(registry.mutex);
+          if (registry.freeRings.empty())
+          {
+            ring = new Ring();
+            registry.rings.push_back(ring);
+          }
+          else
+          {
+            ring = registry.freeRings.back();
+            registry.freeRings.pop_back();
+            ring->head.store(0, boost::memory_order_relaxed);
+          }
+#ifdef __linux__
+          ring->threadId = syscall(SYS_gettid);
+#else
+          ring->threadId = (long)ring;
+#endif
+        }
+        registry.threadRing.reset(ring);
+        getThreadRing() = ring;
+        return ring;
+      }
+
+      /**
+       * @brief Called on a thread when it exits.
+       */
+      inline void releaseRing(Ring * ring)
+      {
+        getThreadRing() = 0;
+        Registry & registry = getRegistry();
+        boost::unique_lock<boost::mutex> lock(registry.mutex);
+        registry.freeRings.push_back(ring);
+      }
+
+      inline void writeEscaped(std::ostream & out, const char * s)
+      {
+        for (; *s; ++s)
+        {
+          if (*s == '"' || *s == '\\')
+          {
+            out << '\\';
+          }
+          out << *s;
+        }
+      }
+    }
+
+    /**
+     * @brief Records an event on the calling thread.
+     *
+     * @param name String with static storage duration.
+     */
+    inline void record(EventType type, const char * name)
+    {
+      Internal::Ring * ring = Internal::getThreadRing();
+      if (!ring)
+      {
+        ring = Internal::registerThread();
+      }
+      boost::uint64_t head = ring->head.load(boost::memory_order_relaxed);
+      Internal::Event & event
+        = ring->events[head & (RABOTNIK_TRACE_RING_SIZE - 1)];
+      event.ticks = Internal::getTicks();
+      event.name = name;
+      event.type = type;
+      ring->head.store(head + 1, boost::memory_order_release);
+    }
+
+    /**
+     * @brief Writes the events of all threads as Chrome trace event JSON.
+     *
+     * May be called while other threads are tracing. Events that may have
+     * been overwritten during the dump are left out.
+     */
+    inline void dump(std::ostream & out)
+    {
+      Internal::Registry & registry = Internal::getRegistry();
+      boost::unique_lock<boost::mutex> lock(registry.mutex);
+
+      boost::uint64_t ticks = Internal::getTicks();
+      boost::uint64_t nsec = Internal::getNsec();
+      double ticksPerUsec = 1000.0;
+      if (nsec > registry.startNsec && ticks > registry.startTicks)
+      {
+        ticksPerUsec = (ticks - registry.startTicks) * 1000.0
+          / (nsec - registry.startNsec);
+      }
+
+      static const char * phases[] = { "B", "E", "i" };
+      std::ios_base::fmtflags flags = out.flags();
+      std::vector<Internal::Event> events;
+      bool isFirst = true;
+      out << "{\"traceEvents\":[";
+      for (size_t r = 0; r < registry.rings.size(); ++r)
+      {
+        Internal::Ring & ring = *registry.rings[r];
+        boost::uint64_t head = ring.head.load(boost::memory_order_acquire);
+        boost::uint64_t first = head > RABOTNIK_TRACE_RING_SIZE
+          ? head - RABOTNIK_TRACE_RING_SIZE
+          : 0;
+        events.clear();
+        for (boost::uint64_t i = first; i < head; ++i)
+        {
+          events.push_back(ring.events[i & (RABOTNIK_TRACE_RING_SIZE - 1)]);
+        }
+
+        //Skip events overwritten while they were being copied.
+        boost::uint64_t newHead = ring.head.load(boost::memory_order_acquire);
+        boost::uint64_t skip = 0;
+        if (newHead - first > RABOTNIK_TRACE_RING_SIZE)
+        {
+          skip = newHead - first - RABOTNIK_TRACE_RING_SIZE;
+        }
+
+        for (size_t i = skip; i < events.size(); ++i)
+        {
+          const Internal::Event & event = events[i];
+          double ts = event.ticks >= registry.startTicks
+            ? (event.ticks - registry.startTicks) / ticksPerUsec
+            : 0.0;
+          out << (isFirst ? "" : ",") << "\n{\"name\":\"";
+          Internal::writeEscaped(out, event.name);
+          out << "\",\"ph\":\"" << phases[event.type]
+            << "\",\"ts\":" << std::fixed << ts
+            << ",\"pid\":" << getpid()
+            << ",\"tid\":" << ring.threadId;
+          if (event.type == EVENT_INSTANT)
+          {
+            out << ",\"s\":\"t\"";
+          }
+          out << "}";
+          isFirst = false;
+        }
+      }
+      out << "\n]}\n";
+      out.flags(flags);
+    }
+
+    /**
+     * @brief Scope guard used by RABOTNIK_TRACE_SCOPE.
+     */
+    class Scope : boost::noncopyable
+    {
+      const char * m_name;
+
+      public:
+        Scope(const char * name)
+          : m_name(name)
+        {
+          record(EVENT_BEGIN, name);
+        }
+
+        ~Scope()
+        {
+          record(EVENT_END, m_name);
+        }
+    };
+
+    namespace Internal
+    {
+      inline void dumpAtExit()
+      {
+        std::ofstream out(getRegistry().exitPath.c_str());
+        dump(out);
+      }
+    }
+
+    /**
+     * @brief Dumps the events into path when the program exits.
+     */
+    inline void dumpAtExit(const char * path)
+    {
+      Internal::Registry & registry = Internal::getRegistry();
+      boost::unique_lock<boost::mutex> lock(registry.mutex);
+      if (registry.exitPath.empty())
+      {
+        atexit(&Internal::dumpAtExit);
+      }
+      registry.exitPath = path;
+    }
+  }
+}
+
+#else
+
+#define RABOTNIK_TRACE_BEGIN(name) ((void)0)
+#define RABOTNIK_TRACE_END(name) ((void)0)
+#define RABOTNIK_TRACE_INSTANT(name) ((void)0)
+#define RABOTNIK_TRACE_SCOPE(name) ((void)0)
+
+#endif
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <Rabotnik/Channel.h>
+#include <Rabotnik/Internal/CacheLine.h>
+#include <Rabotnik/Internal/Parker.h>
+#include <Rabotnik/Internal/StateManager.h>
+#include <Rabotnik/Exception.h>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_array.hpp>
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+
+#include <boost/thread.hpp>
+#include <deque>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Rabotnik
+{
+  /**
+   * @brief Fixed set of worker threads servicing many channels.
+   *
+   * When a buffer is written to an idle channel, the channel is scheduled as
+   * a task on one of the workers. A task processes at most a budget of
+   * buffers and is then put back in the worker's task queue if there is more
+   * to do. Workers run their newest task first, whose data is most likely in
+   * their cache, and idle workers steal the oldest tasks of the other
+   * workers. A task which used its budget while other tasks were waiting is
+   * put behind them. Each worker sleeps on its own, and a scheduled task
+   * wakes only its worker, or one sleeping worker to steal it if its worker
+   * is busy. A channel is never processed by two workers at once,
+   * so handlers keep the single-threaded guarantee of ReaderThread, although
+   * consecutive buffers may be processed on different threads.
+   *
+   * Channels are owned by the user and must be added before the executor is
+   * started. Since a handler runs on any of the workers, it may not have
+   * initializeThread() or uninitializeThread().
+   */
+  class WorkStealingExecutor
+    : public Internal::ChannelListener, boost::noncopyable
+  {
+    enum TaskState {
+      TASK_IDLE,
+      TASK_SCHEDULED,
+      TASK_RUNNING,
+      /**
+       * @brief Buffers were written while the task was running.
+       */
+      TASK_RUNNING_NOTIFIED,
+    };
+
+    struct Worker
+    {
+      boost::mutex mutex;
+      std::deque<unsigned int> tasks;
+      boost::thread thread;
+      Internal::Parker parker;
+      /**
+       * @brief Set while the worker has found no task and is about to
+       * sleep or sleeping.
+       */
+      boost::atomic<bool> isIdle;
+      char padding[RABOTNIK_CACHE_LINE_SIZE];
+    };
+
+    std::vector<Internal::ChannelBase *> m_channels;
+
+    unsigned int m_numWorkers;
+    boost::scoped_array<Worker> m_workers;
+
+    boost::atomic<unsigned int> m_nextWorker;
+
+    unsigned int m_budget;
+    bool m_pinWorkers;
+
+    /**
+     * @brief Checked by the workers for each task, instead of the state,
+     * which takes a lock. Cleared by stop().
+     */
+    boost::atomic<bool> m_isRunning;
+
+    Internal::StateManager m_stateManager;
+
+    /**
+     * @param isYielding
+     *  True if the task used its budget, so it is put behind the waiting
+     *  tasks of the worker.
+     */
+    void pushTask(unsigned int worker, unsigned int task,
+        bool isYielding = false)
+    {
+      {
+        boost::unique_lock<boost::mutex> lock(m_workers[worker].mutex);
+        if (isYielding && !m_workers[worker].tasks.empty())
+        {
+          m_workers[worker].tasks.push_front(task);
+        }
+        else
+        {
+          m_workers[worker].tasks.push_back(task);
+        }
+      }
+      wakeWorker(worker);
+    }
+
+    /**
+     * @brief Wakes worker for a task it was given, or if it is busy, one
+     * idle worker to steal the task.
+     */
+    void wakeWorker(unsigned int worker)
+    {
+      for (unsigned int i = 0; i < m_numWorkers; ++i)
+      {
+        Worker & w = m_workers[(worker + i) % m_numWorkers];
+        if (w.isIdle.load() && w.isIdle.exchange(false))
+        {
+          w.parker.unpark();
+          return;
+        }
+      }
+    }
+
+    bool findTask(unsigned int worker, unsigned int & task)
+    {
+      return popTask(worker, task) || stealTask(worker, task);
+    }
+
+    bool popTask(unsigned int worker, unsigned int & task)
+    {
+      boost::unique_lock<boost::mutex> lock(m_workers[worker].mutex);
+      if (m_workers[worker].tasks.empty())
+      {
+        return false;
+      }
+      task = m_workers[worker].tasks.back();
+      m_workers[worker].tasks.pop_back();
+      return true;
+    }
+
+    bool stealTask(unsigned int thief, unsigned int & task)
+    {
+      for (unsigned int i = 1; i < m_numWorkers; ++i)
+      {
+        Worker & victim = m_workers[(thief + i) % m_numWorkers];
+        boost::unique_lock<boost::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+          task = victim.tasks.front();
+          victim.tasks.pop_front();
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void runTask(unsigned int worker, unsigned int task)
+    {
+      Internal::ChannelBase & channel = *m_channels[task];
+      boost::atomic<unsigned int> & state = channel.getListenerState();
+      state.store(TASK_RUNNING);
+      if (channel.processBuffers(m_budget) < m_budget)
+      {
+        unsigned int expected = TASK_RUNNING;
+        if (state.compare_exchange_strong(expected, TASK_IDLE))
+        {
+          return;
+        }
+      }
+      state.store(TASK_SCHEDULED);
+      pushTask(worker, task, true);
+    }
+
+    void pinWorker(unsigned int worker)
+    {
+#ifdef __linux__
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(worker % CPU_SETSIZE, &cpus);
+      pthread_setaffinity_np(
+          m_workers[worker].thread.native_handle(), sizeof(cpus), &cpus);
+#endif
+    }
+
+    void workerLoop(unsigned int worker)
+    {
+      if (worker == 0)
+      {
+        m_stateManager.setState(READER_STATE_RUNNING);
+        for (unsigned int i = 1; i < m_numWorkers; ++i)
+        {
+          m_workers[i].thread = boost::thread(
+              boost::bind(&WorkStealingExecutor::workerLoop, this, i));
+          if (m_pinWorkers)
+          {
+            pinWorker(i);
+          }
+        }
+      }
+
+      Worker & self = m_workers[worker];
+      while (m_isRunning.load(boost::memory_order_acquire))
+      {
+        unsigned int ticket = self.parker.prepare();
+        unsigned int task;
+        if (findTask(worker, task))
+        {
+          runTask(worker, task);
+          continue;
+        }
+        //Look again after becoming idle, since a task pushed before that
+        //did not wake this worker.
+        self.isIdle = true;
+        if (findTask(worker, task))
+        {
+          self.isIdle = false;
+          runTask(worker, task);
+          continue;
+        }
+        self.parker.park(ticket);
+        self.isIdle = false;
+      }
+
+      if (worker == 0)
+      {
+        for (unsigned int i = 1; i < m_numWorkers; ++i)
+        {
+          m_workers[i].thread.join();
+        }
+        m_stateManager.setState(READER_STATE_STOPPED);
+      }
+    }
+
+    public:
+      /**
+       * @param numWorkers Number of worker threads, by default one per core.
+       */
+      WorkStealingExecutor(
+          unsigned int numWorkers = boost::thread::hardware_concurrency())
+        : m_numWorkers(numWorkers ? numWorkers : 1),
+          m_workers(new Worker[m_numWorkers]),
+          m_nextWorker(0),
+          m_budget(16),
+          m_pinWorkers(false),
+          m_isRunning(false)
+      {
+        for (unsigned int i = 0; i < m_numWorkers; ++i)
+        {
+          m_workers[i].isIdle = false;
+        }
+      }
+
+      /**
+       * @param channel
+       *  Channel to service. Not owned by the executor. Its handler may not
+       *  have initializeThread() or uninitializeThread().
+       */
+      void addChannel(Internal::ChannelBase & channel)
+      {
+        if (m_stateManager.getState() != READER_STATE_STOPPED)
+        {
+          throw Exception("The executor is not stopped.");
+        }
+        if (channel.hasThreadHooks())
+        {
+          throw Exception("Handlers of a WorkStealingExecutor may not have "
+              "initializeThread() or uninitializeThread().");
+        }
+        channel.getListenerState().store(TASK_IDLE);
+        channel.setListener(this, m_channels.size());
+        m_channels.push_back(&channel);
+      }
+
+      /**
+       * @brief Sets the maximum number of buffers a task processes before
+       * yielding. Defaults to 16.
+       */
+      void setBudget(unsigned int budget)
+      {
+        if (!budget)
+        {
+          throw Exception("Budget must be nonzero.");
+        }
+        m_budget = budget;
+      }
+
+      /**
+       * @brief Pins worker N to CPU N when started. Only on Linux.
+       */
+      void setPinWorkers(bool pinWorkers)
+      {
+        m_pinWorkers = pinWorkers;
+      }
+
+      unsigned int getNumWorkers() const
+      {
+        return m_numWorkers;
+      }
+
+      void channelReady(Internal::ChannelBase & channel)
+      {
+        boost::atomic<unsigned int> & state = channel.getListenerState();
+        unsigned int current = state.load();
+        for (;;)
+        {
+          if (current == TASK_IDLE)
+          {
+            if (state.compare_exchange_weak(current, TASK_SCHEDULED))
+            {
+              pushTask(m_nextWorker++ % m_numWorkers,
+                  channel.getListenerIndex());
+              return;
+            }
+          }
+          else if (current == TASK_RUNNING)
+          {
+            if (state.compare_exchange_weak(current, TASK_RUNNING_NOTIFIED))
+            {
+              return;
+            }
+          }
+          else
+          {
+            return;
+          }
+        }
+      }
+
+      void start()
+      {
+        if (m_stateManager.getState() != READER_STATE_STOPPED)
+        {
+          throw Exception("The executor is not stopped.");
+        }
+        m_stateManager.setState(READER_STATE_STARTING);
+        m_isRunning = true;
+        m_workers[0].thread = boost::thread(
+            boost::bind(&WorkStealingExecutor::workerLoop, this, 0));
+        if (m_pinWorkers)
+        {
+          pinWorker(0);
+        }
+      }
+
+      void stop()
+      {
+        m_stateManager.setState(READER_STATE_STOPPING);
+        m_isRunning = false;
+        for (unsigned int i = 0; i < m_numWorkers; ++i)
+        {
+          m_workers[i].parker.unpark();
+        }
+      }
+
+      void join()
+      {
+        m_workers[0].thread.join();
+      }
+
+      void waitForState(ReaderState state) const
+      {
+        m_stateManager.waitForState(state);
+      }
+
+      ~WorkStealingExecutor()
+      {
+        switch (m_stateManager.getState())
+        {
+          case READER_STATE_STARTING:
+            waitForState(READER_STATE_RUNNING);
+            stop();
+            join();
+            break;
+          case READER_STATE_RUNNING:
+            stop();
+            join();
+            break;
+          case READER_STATE_STOPPING:
+            join();
+            break;
+          default:
+            break;
+        }
+        for (size_t i = 0; i < m_channels.size(); ++i)
+        {
+          m_channels[i]->setListener(0);
+        }
+      }
+  };
+}
@@ -0,0 +1,119 @@
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <Rabotnik/ArenaBuffer.h>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+typedef basic_string<char, char_traits<char>, ArenaAllocator<char> >
+  arena_string;
+typedef vector<unsigned int, ArenaAllocator<unsigned int> > arena_vector;
+
+struct Item
+{
+  arena_string name;
+  arena_vector values;
+
+  Item(Arena & arena)
+    : name(ArenaAllocator<char>(arena)),
+      values(ArenaAllocator<unsigned int>(arena))
+  {
+  }
+};
+
+typedef ArenaBuffer<StaticQueue<Item, 20>, 65536> queue;
+
+
+class BufferHandler
+{
+  unsigned int i;
+
+  public:
+    BufferHandler()
+      : i(0)
+    {
+    }
+
+    void processBuffer(queue & q, unsigned int usec)
+    {
+      if (!q.length())
+      {
+        std::cerr << "EMPTY!" << std::endl;
+        exit(0);
+      }
+
+      BOOST_FOREACH(const Item & item, q)
+      {
+        if (item.values.size() != i % 50
+            || item.name.size() != i % 50 + 20
+            || item.name[i % 50 + 19] != char('a' + i % 26))
+        {
+          std::cerr << "FAILURE!" << std::endl;
+          exit(0);
+        }
+        BOOST_FOREACH(unsigned int u, item.values)
+        {
+          if (u != i)
+          {
+            std::cerr << "FAILURE!" << std::endl;
+            exit(0);
+          }
+        }
+        ++i;
+      }
+    }
+};
+
+typedef ReaderThread<PushBufferQueue<queue, 3>, BufferHandler> reader_thread;
+
+reader_thread g_readerThread;
+
+void writer()
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    for (unsigned int i = 1; i <= 20; ++i)
+    {
+      queue & q = g_readerThread.beginWriting();
+      for (unsigned int j = 0; j < i; ++j)
+      {
+        //Construct in place, since a copy would allocate from the arena
+        //again.
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+        Item & item = q.emplace_back(q.getArena());
+        item.name.assign(d % 50 + 20, char('a' + d % 26));
+        item.values.assign(d % 50, d);
+#else
+        Item item(q.getArena());
+        item.name.assign(d % 50 + 20, char('a' + d % 26));
+        item.values.assign(d % 50, d);
+        q.push_back(item);
+#endif
+        ++d;
+      }
+      g_readerThread.finishWriting();
+    }
+  }
+}
+
+int main()
+{
+  boost::thread w(writer);
+  g_readerThread.start();
+  w.join();
+  g_readerThread.stop();
+  g_readerThread.join();
+}
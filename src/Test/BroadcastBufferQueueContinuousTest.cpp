@@ -0,0 +1,190 @@
+
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/BroadcastBufferQueue.h>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+#include <boost/atomic.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+typedef StaticQueue<unsigned int, 10> queue;
+typedef BroadcastBufferQueue<queue, 4, 3> broadcast_queue;
+
+broadcast_queue g_queue;
+
+//Number of buffers processed by the first two readers.
+boost::atomic<unsigned int> g_numProcessed[2];
+
+class BufferHandler
+{
+  unsigned int i;
+  unsigned int m_numBuffers;
+  int m_index;
+
+  public:
+    BufferHandler(int index)
+      : i(0),
+        m_numBuffers(0),
+        m_index(index)
+    {
+    }
+
+    void processBuffer(const queue & q, unsigned int usec) 
+    {
+      if (m_index == 2 
+          && (g_numProcessed[0] <= m_numBuffers 
+            || g_numProcessed[1] <= m_numBuffers))
+      {
+        std::cerr << "DEPENDENCY FAILURE!" << std::endl;
+        exit(0);
+      }
+
+      BOOST_FOREACH(unsigned int u, q)
+      {
+        if (u != i)
+        {
+          std::cerr << "FAILURE!" << std::endl;
+          exit(0);
+        }
+
+        i = i ^ (i << 1);
+        ++i;
+        i &= 0xFFFFFF;
+      }
+
+      ++m_numBuffers;
+      if (m_index < 2)
+      {
+        ++g_numProcessed[m_index];
+      }
+    }
+};
+
+typedef ReaderThread<
+  BroadcastBufferQueueReader<broadcast_queue>, 
+  BufferHandler
+> reader_thread;
+
+reader_thread g_readerThreads[3] = { 0, 1, 2 };
+
+void writer() 
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    for (int i = 7; i <= 10; ++i)
+    {
+      queue & q = g_queue.beginWriting();
+      queue::writer w = q.beginWriting();
+      for (int j = 0; j < i; ++j)
+      {
+        w.push_back(d);
+        d = d ^ (d << 1);
+        ++d;
+        d &= 0xFFFFFF;
+      }
+      q.finishWriting(w);
+      g_queue.finishWriting();
+    }
+  }
+}
+
+/**
+ * @brief Counts live instances, to check that the queue destroys every
+ * buffer it constructed.
+ */
+struct CountedBuffer
+{
+  static int numLive;
+
+  CountedBuffer()
+  {
+    ++numLive;
+  }
+
+  ~CountedBuffer()
+  {
+    --numLive;
+  }
+};
+
+int CountedBuffer::numLive = 0;
+
+void checkUnfinishedBuffer()
+{
+  //Before and after the ring has wrapped.
+  for (unsigned int n = 0; n < 8; ++n)
+  {
+    {
+      BroadcastBufferQueue<CountedBuffer, 4, 1> q;
+      q.addReader();
+      for (unsigned int i = 0; i < n; ++i)
+      {
+        q.beginWriting();
+        q.finishWriting();
+        q.beginReading(0);
+        q.finishReading(0);
+      }
+      q.beginWriting();
+    }
+    if (CountedBuffer::numLive != 0)
+    {
+      std::cerr << "FAILURE!" << std::endl;
+      exit(0);
+    }
+  }
+}
+
+void checkCyclicDependency()
+{
+  BroadcastBufferQueue<queue, 4, 3> q;
+  for (int i = 0; i < 3; ++i)
+  {
+    q.addReader();
+  }
+  q.addDependency(1, 0);
+  q.addDependency(2, 1);
+  try
+  {
+    q.addDependency(0, 2);
+  }
+  catch (const Exception &)
+  {
+    return;
+  }
+  std::cerr << "FAILURE!" << std::endl;
+  exit(0);
+}
+
+int main() 
+{
+  checkUnfinishedBuffer();
+  checkCyclicDependency();
+  for (int i = 0; i < 3; ++i)
+  {
+    g_readerThreads[i].getBufferQueue().attach(g_queue, g_queue.addReader());
+  }
+  g_queue.addDependency(2, 0);
+  g_queue.addDependency(2, 1);
+
+  for (int i = 0; i < 3; ++i)
+  {
+    g_readerThreads[i].start();
+  }
+  boost::thread w(writer);
+  w.join();
+  for (int i = 0; i < 3; ++i)
+  {
+    g_readerThreads[i].stop();
+    g_readerThreads[i].join();
+  }
+}
@@ -0,0 +1,95 @@
+#include <Rabotnik/ConflatingBufferQueue.h>
+#include <Rabotnik/ReaderThread.h>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+const unsigned int NUM_KEYS = 100;
+
+typedef ConflatingBufferQueue<unsigned int, unsigned int, NUM_KEYS>
+  conflating_queue;
+
+class BufferHandler
+{
+  unsigned int m_last[NUM_KEYS];
+  bool m_isSeen[NUM_KEYS];
+  unsigned int m_numBuffers;
+
+  public:
+    BufferHandler()
+      : m_numBuffers(0)
+    {
+      for (unsigned int i = 0; i < NUM_KEYS; ++i)
+      {
+        m_last[i] = 0;
+        m_isSeen[i] = false;
+      }
+    }
+
+    void processBuffer(conflating_queue::buffer & q)
+    {
+      if (!q.length())
+      {
+        std::cerr << "FAILURE!" << std::endl;
+        exit(0);
+      }
+      BOOST_FOREACH(const conflating_queue::entry & e, q)
+      {
+        //Each key at most once per buffer, and never older than before.
+        if (e.first >= NUM_KEYS || m_isSeen[e.first]
+            || e.second <= m_last[e.first])
+        {
+          std::cerr << "FAILURE!" << std::endl;
+          exit(0);
+        }
+        m_isSeen[e.first] = true;
+        m_last[e.first] = e.second;
+      }
+      BOOST_FOREACH(const conflating_queue::entry & e, q)
+      {
+        m_isSeen[e.first] = false;
+      }
+      //Be slow, so that updates are conflated.
+      usleep(100);
+      if (++m_numBuffers % 10000 == 0)
+      {
+        std::cerr << m_numBuffers << " buffers, last of key 0: "
+          << m_last[0] << std::endl;
+      }
+    }
+};
+
+typedef ReaderThread<conflating_queue, BufferHandler> reader_thread;
+
+reader_thread g_readerThread;
+
+void writer()
+{
+  unsigned int version = 0;
+  for(;;)
+  {
+    ++version;
+    for (unsigned int key = 0; key < NUM_KEYS; ++key)
+    {
+      g_readerThread.getBufferQueue().update(key, version);
+    }
+  }
+}
+
+int main()
+{
+  boost::thread w(writer);
+  g_readerThread.start();
+  w.join();
+  g_readerThread.stop();
+  g_readerThread.join();
+}
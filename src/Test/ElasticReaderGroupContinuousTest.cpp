@@ -0,0 +1,155 @@
+#include <Rabotnik/ElasticReaderGroup.h>
+#include <Rabotnik/MultiConsumerBufferQueue.h>
+#include <Rabotnik/StaticQueue.h>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+typedef StaticQueue<unsigned int, 10> queue;
+
+boost::atomic<int> g_numThreads(0);
+
+class BufferHandler
+{
+  bool m_isInitialized;
+
+  public:
+    BufferHandler()
+      : m_isInitialized(false)
+    {
+    }
+
+    void initializeThread()
+    {
+      m_isInitialized = true;
+      ++g_numThreads;
+    }
+
+    void uninitializeThread()
+    {
+      --g_numThreads;
+    }
+
+    void processBuffer(queue & q)
+    {
+      if (!m_isInitialized || q.length() != 10)
+      {
+        std::cerr << "FAILURE!" << std::endl;
+        exit(0);
+      }
+
+      unsigned int first = *q.begin();
+      BOOST_FOREACH(unsigned int u, q)
+      {
+        if (u != first++)
+        {
+          std::cerr << "FAILURE!" << std::endl;
+          exit(0);
+        }
+      }
+      usleep(100);
+    }
+};
+
+typedef ElasticReaderGroup<MultiConsumerBufferQueue<queue, 16>, BufferHandler>
+  reader_group;
+
+reader_group g_readerGroup;
+
+void writer()
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    //A burst needing several workers.
+    unsigned int maxWorkers = 0;
+    for (int i = 0; i < 5000; ++i)
+    {
+      queue & q = g_readerGroup.beginWriting();
+      for (int j = 0; j < 10; ++j)
+      {
+        q.push_back(d++);
+      }
+      g_readerGroup.finishWriting();
+      maxWorkers = std::max(maxWorkers, g_readerGroup.getNumWorkers());
+    }
+    if (maxWorkers < 2)
+    {
+      std::cerr << "FAILURE!" << std::endl;
+      exit(0);
+    }
+
+    //Idle, until the workers are retired back to the minimum.
+    for (int i = 0; g_readerGroup.getNumWorkers() > 1; ++i)
+    {
+      if (i == 200)
+      {
+        std::cerr << "FAILURE!" << std::endl;
+        exit(0);
+      }
+      usleep(10000);
+    }
+    if (g_numThreads != 1)
+    {
+      std::cerr << "FAILURE!" << std::endl;
+      exit(0);
+    }
+    std::cerr << "max workers: " << maxWorkers
+      << ", initialized: " << g_numThreads << std::endl;
+  }
+}
+
+/**
+ * @brief Holds the first buffer while the rest are read and written again,
+ * which blocks the writer if it waits for the held buffer.
+ */
+void checkSlowReader()
+{
+  MultiConsumerBufferQueue<queue, 4> q;
+  for (unsigned int i = 0; i < 4; ++i)
+  {
+    q.beginWriting().push_back(i);
+    q.finishWriting();
+  }
+  queue * held = q.beginReading(boost::posix_time::milliseconds(0));
+  for (unsigned int i = 1; i < 100; ++i)
+  {
+    queue * b = q.beginReading(boost::posix_time::milliseconds(0));
+    if (!b || *b->begin() != i)
+    {
+      std::cerr << "FAILURE!" << std::endl;
+      exit(0);
+    }
+    q.finishReading(*b);
+    q.beginWriting().push_back(i + 3);
+    q.finishWriting();
+  }
+  if (*held->begin() != 0 || q.getNumFullBuffers() != 3)
+  {
+    std::cerr << "FAILURE!" << std::endl;
+    exit(0);
+  }
+  q.finishReading(*held);
+}
+
+int main()
+{
+  checkSlowReader();
+  g_readerGroup.setWorkerBounds(1, 4);
+  g_readerGroup.setScaleDownDelay(100000000);
+  boost::thread w(writer);
+  g_readerGroup.start();
+  w.join();
+  g_readerGroup.stop();
+  g_readerGroup.join();
+}
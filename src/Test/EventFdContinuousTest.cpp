@@ -0,0 +1,139 @@
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <Rabotnik/PullBufferQueue.h>
+#include <iostream>
+#include <cstdlib>
+#include <poll.h>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+typedef StaticQueue<unsigned int, 100> queue;
+
+PushBufferQueue<queue, 3> g_pushQueue;
+PullBufferQueue<queue> g_pullQueue;
+
+void fail()
+{
+  std::cerr << "FAILURE!" << std::endl;
+  exit(0);
+}
+
+void pushWriter()
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    for (unsigned int i = 0; i <= 10; ++i)
+    {
+      queue & q = g_pushQueue.beginWriting();
+      for (unsigned int j = 0; j < i; ++j)
+      {
+        q.push_back(d++);
+      }
+      g_pushQueue.finishWriting();
+    }
+    //Let the event loop catch up and sleep now and then.
+    if (d % 7 == 0)
+    {
+      usleep(100);
+    }
+  }
+}
+
+void pullWriter()
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    queue * q = &g_pullQueue.beginWriting();
+    while (q->length() > 90)
+    {
+      g_pullQueue.finishWriting();
+      usleep(10);
+      q = &g_pullQueue.beginWriting();
+    }
+    q->push_back(d++);
+    g_pullQueue.finishWriting();
+  }
+}
+
+int main()
+{
+  pollfd fds[2];
+  fds[0].fd = g_pushQueue.enableEventFd();
+  fds[1].fd = g_pullQueue.enableEventFd();
+  fds[0].events = fds[1].events = POLLIN;
+  if (fds[0].fd < 0 || fds[0].fd != g_pushQueue.getEventFd()
+      || fds[1].fd < 0 || fds[1].fd != g_pullQueue.getEventFd())
+  {
+    fail();
+  }
+
+  boost::thread pushThread(pushWriter);
+  boost::thread pullThread(pullWriter);
+
+  unsigned int pushNext = 0;
+  unsigned int pullNext = 0;
+  boost::uint64_t numWakeups = 0;
+  boost::uint64_t numBuffers = 0;
+  for(;;)
+  {
+    //The writers never stop, so the queues must become ready.
+    if (poll(fds, 2, 1000) <= 0)
+    {
+      fail();
+    }
+    ++numWakeups;
+
+    if (fds[0].revents & POLLIN)
+    {
+      //Clear before reading, so that buffers written meanwhile signal again.
+      g_pushQueue.clearEvent();
+      while (queue * q = g_pushQueue.tryBeginReading())
+      {
+        BOOST_FOREACH(unsigned int u, *q)
+        {
+          if (u != pushNext++)
+          {
+            fail();
+          }
+        }
+        g_pushQueue.finishReading();
+        ++numBuffers;
+      }
+    }
+
+    if (fds[1].revents & POLLIN)
+    {
+      g_pullQueue.clearEvent();
+      if (queue * q = g_pullQueue.tryBeginReading())
+      {
+        //Items are never lost with a pull queue, only batched.
+        BOOST_FOREACH(unsigned int u, *q)
+        {
+          if (u != pullNext++)
+          {
+            fail();
+          }
+        }
+        g_pullQueue.finishReading();
+        ++numBuffers;
+      }
+    }
+
+    if (numWakeups % 100000 == 0)
+    {
+      std::cerr << numWakeups << " wakeups, " << numBuffers << " buffers, "
+        << pushNext << " pushed items, " << pullNext << " pulled items"
+        << std::endl;
+    }
+  }
+}
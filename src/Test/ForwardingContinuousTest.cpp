@@ -0,0 +1,144 @@
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+
+#ifndef RABOTNIK_HAS_VARIADIC_FORWARDING
+#error This test requires variadic templates and rvalue references.
+#endif
+
+using namespace Rabotnik;
+using namespace std;
+
+void fail()
+{
+  std::cerr << "FAILURE!" << std::endl;
+  exit(0);
+}
+
+/**
+ * @brief Fails on copies, which forwarding and moving must avoid.
+ */
+struct Item
+{
+  unsigned int id;
+  std::string name;
+
+  Item(unsigned int itemId, const std::string & itemName)
+    : id(itemId),
+      name(itemName)
+  {
+  }
+
+  Item(Item && other)
+    : id(other.id),
+      name(std::move(other.name))
+  {
+  }
+
+  Item(const Item & other)
+    : id(other.id),
+      name(other.name)
+  {
+    fail();
+  }
+};
+
+/**
+ * @brief Buffer constructed with arguments forwarded by beginWriting(). The
+ * default argument is for the buffer queue concept check.
+ */
+struct Frame : StaticQueue<Item, 10>
+{
+  unsigned int sequence;
+
+  Frame(unsigned int frameSequence = 0)
+    : sequence(frameSequence)
+  {
+  }
+};
+
+class BufferHandler
+{
+  unsigned int m_next;
+  unsigned int m_sequence;
+  std::string m_name;
+
+  public:
+    BufferHandler(unsigned int first, const char * name)
+      : m_next(first),
+        m_sequence(0),
+        m_name(name)
+    {
+    }
+
+    void processBuffer(Frame & frame)
+    {
+      if (frame.sequence != m_sequence++)
+      {
+        fail();
+      }
+      for (Frame::iterator it = frame.begin(); it != frame.end(); ++it)
+      {
+        if (it->id != m_next || it->name != m_name)
+        {
+          fail();
+        }
+        ++m_next;
+      }
+      if (m_sequence % 1000000 == 0)
+      {
+        std::cerr << m_sequence << " frames" << std::endl;
+      }
+    }
+};
+
+typedef ReaderThread<PushBufferQueue<Frame, 3>, BufferHandler> reader_thread;
+
+const unsigned int FIRST = 1000;
+const char * NAME = "a name too long for the small string buffer";
+
+//Constructs the handler with forwarded arguments.
+reader_thread g_readerThread(FIRST, NAME);
+
+void writer()
+{
+  unsigned int d = FIRST;
+  for (unsigned int sequence = 0;; ++sequence)
+  {
+    Frame & frame = g_readerThread.beginWriting(sequence);
+    unsigned int n = sequence % 10;
+    //Emplace and move into the queue, and emplace with a writer.
+    for (unsigned int i = 0; i < n / 3; ++i)
+    {
+      frame.emplace_back(d++, NAME);
+    }
+    for (unsigned int i = n / 3; i < n / 2; ++i)
+    {
+      frame.push_back(Item(d++, NAME));
+    }
+    Frame::writer w = frame.beginWriting();
+    for (unsigned int i = n / 2; i < n; ++i)
+    {
+      w.emplace_back(d++, std::string(NAME));
+    }
+    frame.finishWriting(w);
+    g_readerThread.finishWriting();
+  }
+}
+
+int main()
+{
+  boost::thread w(writer);
+  g_readerThread.start();
+  w.join();
+  g_readerThread.stop();
+  g_readerThread.join();
+}
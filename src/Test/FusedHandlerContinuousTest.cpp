@@ -0,0 +1,137 @@
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/FusedHandler.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <iostream>
+#include <cstdlib>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+typedef StaticQueue<unsigned int, 10> queue;
+
+/**
+ * @brief Number of stages initialized, to check their order.
+ */
+unsigned int g_numInitialized = 0;
+
+void checkInitialized(unsigned int stage)
+{
+  if (g_numInitialized++ != stage)
+  {
+    std::cerr << "FAILURE!" << std::endl;
+    exit(0);
+  }
+}
+
+struct EvenFilter
+{
+  void initializeThread()
+  {
+    checkInitialized(0);
+  }
+
+  template<typename _Sink>
+  void processItem(unsigned int item, _Sink & sink)
+  {
+    if (item % 2 == 0)
+    {
+      sink(item);
+    }
+  }
+};
+
+/**
+ * @brief Outputs each item and three times it.
+ */
+struct Triple
+{
+  void initializeThread()
+  {
+    checkInitialized(1);
+  }
+
+  template<typename _Sink>
+  void processItem(unsigned int item, _Sink & sink)
+  {
+    sink(item);
+    sink(item * 3);
+  }
+};
+
+class Checker
+{
+  unsigned int m_next;
+  bool m_isTripled;
+  unsigned int m_numItems;
+
+  public:
+    Checker()
+      : m_next(0),
+        m_isTripled(false),
+        m_numItems(0)
+    {
+    }
+
+    void initializeThread()
+    {
+      checkInitialized(2);
+    }
+
+    template<typename _Sink>
+    void processItem(unsigned int item, _Sink & /*sink*/)
+    {
+      if (g_numInitialized != 3
+          || item != (m_isTripled ? m_next * 3 : m_next))
+      {
+        std::cerr << "FAILURE!" << std::endl;
+        exit(0);
+      }
+      if (m_isTripled)
+      {
+        m_next += 2;
+      }
+      m_isTripled = !m_isTripled;
+      if (++m_numItems % 1000000 == 0)
+      {
+        std::cerr << m_numItems << " items" << std::endl;
+      }
+    }
+};
+
+typedef FusedHandler<EvenFilter, Triple, Checker> handler;
+
+typedef ReaderThread<PushBufferQueue<queue, 3>, handler> reader_thread;
+
+reader_thread g_readerThread;
+
+void writer()
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    for (unsigned int i = 0; i <= 10; ++i)
+    {
+      queue & q = g_readerThread.beginWriting();
+      for (unsigned int j = 0; j < i; ++j)
+      {
+        q.push_back(d++);
+      }
+      g_readerThread.finishWriting();
+    }
+  }
+}
+
+int main()
+{
+  boost::thread w(writer);
+  g_readerThread.start();
+  w.join();
+  g_readerThread.stop();
+  g_readerThread.join();
+}
@@ -0,0 +1,125 @@
+#include <Rabotnik/HelperTeam.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/StaticQueue.h>
+#include <iostream>
+#include <cstdlib>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+typedef StaticQueue<boost::uint64_t, 200000> queue;
+
+struct Square
+{
+  void operator()(queue::iterator begin, queue::iterator end) const
+  {
+    for (; begin != end; ++begin)
+    {
+      *begin *= *begin;
+    }
+  }
+};
+
+struct Sum
+{
+  boost::uint64_t operator()(
+      queue::const_iterator begin, queue::const_iterator end) const
+  {
+    boost::uint64_t sum = 0;
+    for (; begin != end; ++begin)
+    {
+      sum += *begin;
+    }
+    return sum;
+  }
+
+  boost::uint64_t operator()(boost::uint64_t a, boost::uint64_t b) const
+  {
+    return a + b;
+  }
+};
+
+class BufferHandler
+{
+  HelperTeam m_team;
+  unsigned int m_numBuffers;
+
+  public:
+    BufferHandler()
+      : m_team(3),
+        m_numBuffers(0)
+    {
+      m_team.setPinHelpers(true);
+    }
+
+    void initializeThread()
+    {
+      m_team.start();
+      if (m_team.isPinningFailed())
+      {
+        std::cerr << "FAILURE!" << std::endl;
+        exit(0);
+      }
+    }
+
+    void uninitializeThread()
+    {
+      m_team.stop();
+    }
+
+    void processBuffer(queue & q)
+    {
+      //The buffer holds 0, 1, ..., n - 1.
+      boost::uint64_t n = q.length();
+      m_team.setSchedule(m_numBuffers % 2
+          ? HELPER_SCHEDULE_STATIC : HELPER_SCHEDULE_DYNAMIC);
+      m_team.parallelFor(q.begin(), q.end(), Square());
+      boost::uint64_t sum = m_team.parallelReduce(
+          queue::const_iterator(q.begin()), queue::const_iterator(q.end()),
+          boost::uint64_t(0), Sum(), Sum());
+      if (sum != (n - 1) * n * (2 * n - 1) / 6)
+      {
+        std::cerr << "FAILURE!" << std::endl;
+        exit(0);
+      }
+      if (++m_numBuffers % 1000 == 0)
+      {
+        std::cerr << m_numBuffers << " buffers" << std::endl;
+      }
+    }
+};
+
+typedef ReaderThread<PushBufferQueue<queue, 3>, BufferHandler> reader_thread;
+
+reader_thread g_readerThread;
+
+void writer()
+{
+  for(;;)
+  {
+    queue & q = g_readerThread.beginWriting();
+    unsigned int n = 1 + rand() % queue::capacity;
+    queue::writer w = q.beginWriting();
+    for (unsigned int i = 0; i < n; ++i)
+    {
+      w.push_back(i);
+    }
+    q.finishWriting(w);
+    g_readerThread.finishWriting();
+  }
+}
+
+int main()
+{
+  boost::thread w(writer);
+  g_readerThread.start();
+  w.join();
+  g_readerThread.stop();
+  g_readerThread.join();
+}
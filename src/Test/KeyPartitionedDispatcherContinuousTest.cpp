@@ -0,0 +1,95 @@
+
+#include <Rabotnik/KeyPartitionedDispatcher.h>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+const unsigned int NUM_KEYS = 1000;
+
+struct Record
+{
+  unsigned int key;
+  unsigned int sequence;
+};
+
+struct KeyExtractor
+{
+  typedef unsigned int result_type;
+
+  unsigned int operator()(const Record & record) const
+  {
+    return record.key;
+  }
+};
+
+//Next expected sequence number of each key. Each key is only touched by one
+//shard at a time.
+unsigned int g_nextSequences[NUM_KEYS];
+
+class BufferHandler
+{
+  public:
+    template<typename _Buffer>
+    void processBuffer(_Buffer & q, unsigned int usec) 
+    {
+      BOOST_FOREACH(const Record & r, q)
+      {
+        if (r.sequence != g_nextSequences[r.key])
+        {
+          std::cerr << "FAILURE!" << std::endl;
+          exit(0);
+        }
+        ++g_nextSequences[r.key];
+      }
+    }
+};
+
+typedef KeyPartitionedDispatcher<
+  Record, 
+  KeyExtractor, 
+  BufferHandler, 
+  4, 
+  32
+> dispatcher;
+
+dispatcher g_dispatcher;
+
+void writer() 
+{
+  unsigned int sequences[NUM_KEYS] = { 0 };
+  unsigned int d = 0;
+  for(;;)
+  {
+    for (int i = 0; i < 100000; ++i)
+    {
+      //Skewed key distribution, so that rebalancing has something to do.
+      d = d ^ (d << 1);
+      ++d;
+      d &= 0xFFFFFF;
+      Record r;
+      r.key = ((d % NUM_KEYS) * (d % 7 == 0 ? 1 : 0) + (d % 3)) % NUM_KEYS;
+      r.sequence = sequences[r.key]++;
+      g_dispatcher.dispatch(r);
+    }
+    g_dispatcher.rebalance();
+  }
+}
+
+int main() 
+{
+  g_dispatcher.setMaxLatency(100000);
+  g_dispatcher.start();
+  boost::thread w(writer);
+  w.join();
+  g_dispatcher.stop();
+  g_dispatcher.join();
+}
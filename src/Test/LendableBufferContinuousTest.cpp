@@ -0,0 +1,198 @@
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/LendableBuffer.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <iostream>
+#include <cstdlib>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/foreach.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+typedef StaticQueue<unsigned int, 10> queue;
+typedef LendableBuffer<queue> buffer;
+
+const unsigned int BUFFER_COUNT = 3;
+/**
+ * @brief One slab more than the queue holds, so the writer always finds a
+ * free one once the reader has released the rest.
+ */
+const unsigned int NUM_SLABS = BUFFER_COUNT + 1;
+const unsigned int SLAB_SIZE = 1000;
+
+void fail()
+{
+  std::cerr << "FAILURE!" << std::endl;
+  exit(0);
+}
+
+/**
+ * @brief Memory lent by the writer.
+ */
+struct Slab
+{
+  unsigned int data[SLAB_SIZE];
+  boost::atomic<bool> isLent;
+  /**
+   * @brief Set by the handler, so that releasing before reading fails.
+   */
+  boost::atomic<bool> isRead;
+};
+
+Slab g_slabs[NUM_SLABS];
+boost::atomic<boost::uint64_t> g_numLent(0);
+boost::atomic<boost::uint64_t> g_numReleased(0);
+
+void release(void * context, void * data, size_t size)
+{
+  Slab * slab = static_cast<Slab *>(context);
+  if (data != slab->data || size != SLAB_SIZE * sizeof(unsigned int)
+      || !slab->isRead)
+  {
+    fail();
+  }
+  //Releasing twice finds the slab no longer lent.
+  if (!slab->isLent.exchange(false))
+  {
+    fail();
+  }
+  ++g_numReleased;
+}
+
+class BufferHandler
+{
+  unsigned int m_next;
+  boost::uint64_t m_numBuffers;
+
+  public:
+    BufferHandler()
+      : m_next(0),
+        m_numBuffers(0)
+    {
+    }
+
+    void processBuffer(buffer & b)
+    {
+      if (b.isLent())
+      {
+        Slab * slab = reinterpret_cast<Slab *>(b.getData());
+        if (!slab->isLent || slab->isRead
+            || b.getSize() != SLAB_SIZE * sizeof(unsigned int))
+        {
+          fail();
+        }
+        for (unsigned int i = 0; i < SLAB_SIZE; ++i)
+        {
+          if (slab->data[i] != m_next++)
+          {
+            fail();
+          }
+        }
+        slab->isRead = true;
+      }
+      else
+      {
+        BOOST_FOREACH(unsigned int u, b.getBuffer())
+        {
+          if (u != m_next++)
+          {
+            fail();
+          }
+        }
+      }
+      if (++m_numBuffers % 100000 == 0)
+      {
+        std::cerr << m_numBuffers << " buffers, " << g_numLent << " lent, "
+          << g_numReleased << " released" << std::endl;
+      }
+    }
+};
+
+typedef ReaderThread<PushBufferQueue<buffer, BUFFER_COUNT>, BufferHandler>
+  reader_thread;
+reader_thread g_readerThread;
+
+Slab & getFreeSlab()
+{
+  for (;;)
+  {
+    for (unsigned int i = 0; i < NUM_SLABS; ++i)
+    {
+      if (!g_slabs[i].isLent)
+      {
+        return g_slabs[i];
+      }
+    }
+    boost::this_thread::yield();
+  }
+}
+
+void writer()
+{
+  unsigned int d = 0;
+  for (unsigned int n = 0;; ++n)
+  {
+    //Every third buffer is small enough for the inline buffer.
+    if (n % 3 == 0)
+    {
+      buffer & b = g_readerThread.beginWriting();
+      for (unsigned int i = 0; i < n % 10; ++i)
+      {
+        b.getBuffer().push_back(d++);
+      }
+      g_readerThread.finishWriting();
+      continue;
+    }
+
+    Slab & slab = getFreeSlab();
+    for (unsigned int i = 0; i < SLAB_SIZE; ++i)
+    {
+      slab.data[i] = d++;
+    }
+    slab.isRead = false;
+    slab.isLent = true;
+    ++g_numLent;
+    //Lend both through the forwarding constructor and with lend().
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+    if (n % 3 == 1)
+    {
+      g_readerThread.beginWriting(slab.data,
+          SLAB_SIZE * sizeof(unsigned int), release, &slab);
+      g_readerThread.finishWriting();
+      continue;
+    }
+#endif
+    buffer & b = g_readerThread.beginWriting();
+    b.lend(slab.data, SLAB_SIZE * sizeof(unsigned int), release, &slab);
+    g_readerThread.finishWriting();
+  }
+}
+
+int main()
+{
+  boost::thread w(writer);
+  g_readerThread.start();
+  for (;;)
+  {
+    boost::uint64_t numReleased = g_numReleased;
+    boost::this_thread::sleep(boost::posix_time::seconds(2));
+    //The writer runs out of slabs if they are not released.
+    if (g_numReleased == numReleased)
+    {
+      fail();
+    }
+    //Released at most once per lent buffer. Load the releases first, since
+    //both only grow.
+    numReleased = g_numReleased;
+    if (numReleased > g_numLent)
+    {
+      fail();
+    }
+  }
+}
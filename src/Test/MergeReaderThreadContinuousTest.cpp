@@ -0,0 +1,241 @@
+#include <Rabotnik/MergeReaderThread.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <Rabotnik/StaticQueue.h>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+const unsigned int NUM_STREAMS = 3;
+
+struct Item
+{
+  boost::uint64_t timestamp;
+  unsigned int stream;
+};
+
+struct TimestampExtractor
+{
+  typedef boost::uint64_t result_type;
+
+  result_type operator()(const Item & item) const
+  {
+    return item.timestamp;
+  }
+};
+
+typedef StaticQueue<Item, 10> queue;
+
+/**
+ * @brief Xorshift generator, so that each writer has its own state.
+ */
+class Random
+{
+  boost::uint32_t m_state;
+
+  public:
+    Random(boost::uint32_t seed)
+      : m_state(seed * 2654435761U + 1)
+    {
+    }
+
+    unsigned int operator()()
+    {
+      m_state ^= m_state << 13;
+      m_state ^= m_state >> 17;
+      m_state ^= m_state << 5;
+      return m_state;
+    }
+};
+
+/**
+ * @param _IsStrict
+ *  Whether all items must be in timestamp order, or only the items of each
+ *  stream, when a max skew lets items be late.
+ */
+template<bool _IsStrict>
+class BufferHandler
+{
+  boost::uint64_t m_last[NUM_STREAMS];
+  boost::atomic<boost::uint64_t> m_numItems;
+
+  public:
+    BufferHandler()
+      : m_numItems(0)
+    {
+      for (unsigned int i = 0; i < NUM_STREAMS; ++i)
+      {
+        m_last[i] = 0;
+      }
+    }
+
+    void processRun(unsigned int stream, queue::const_iterator begin,
+        queue::const_iterator end)
+    {
+      if (begin == end)
+      {
+        std::cerr << "FAILURE!" << std::endl;
+        exit(0);
+      }
+      boost::uint64_t & last = m_last[_IsStrict ? 0 : stream];
+      for (; begin != end; ++begin)
+      {
+        if (begin->stream != stream || begin->timestamp < last)
+        {
+          std::cerr << "FAILURE!" << std::endl;
+          exit(0);
+        }
+        last = begin->timestamp;
+        boost::uint64_t numItems = ++m_numItems;
+        if (numItems % 1000000 == 0)
+        {
+          std::cerr << numItems << (_IsStrict ? " items" : " skewed items")
+            << std::endl;
+        }
+      }
+    }
+
+    boost::uint64_t getNumItems() const
+    {
+      return m_numItems;
+    }
+};
+
+typedef MergeReaderThread<PushBufferQueue<queue, 4>, TimestampExtractor,
+  BufferHandler<true>, NUM_STREAMS> reader_thread;
+typedef MergeReaderThread<PushBufferQueue<queue, 4>, TimestampExtractor,
+  BufferHandler<false>, NUM_STREAMS> skew_reader_thread;
+
+reader_thread g_readerThread;
+skew_reader_thread g_skewReaderThread;
+
+/**
+ * @param isSkewed
+ *  Whether the reader has a max skew. Then stream 0 stops writing for a
+ *  while now and then, and no buffers are empty, so that a full queue spans
+ *  at least 3 * NUM_STREAMS past its head and the merge always gets past
+ *  the stalled stream.
+ */
+template<typename _ReaderThread>
+void writer(_ReaderThread * readerThread, unsigned int stream, bool isSkewed)
+{
+  Random random(stream * 2 + isSkewed);
+  boost::uint64_t timestamp = stream;
+  for (unsigned int n = 1;; ++n)
+  {
+    queue & q = readerThread->beginWriting(stream);
+    //Write a varying number of items with varying gaps, so that runs of
+    //different streams interleave.
+    unsigned int numItems = isSkewed ? 1 + random() % 10 : random() % 11;
+    for (unsigned int i = 0; i < numItems; ++i)
+    {
+      Item item = { timestamp, stream };
+      q.push_back(item);
+      timestamp += NUM_STREAMS * (1 + random() % 4);
+    }
+    readerThread->finishWriting(stream);
+    if (isSkewed && stream == 0 && n % 1000 == 0)
+    {
+      usleep(10000);
+    }
+    //Let streams run empty now and then.
+    else if (random() % 100 == 0)
+    {
+      usleep(random() % 100);
+    }
+  }
+}
+
+void writeItem(reader_thread & readerThread, unsigned int stream,
+    boost::uint64_t timestamp)
+{
+  queue & q = readerThread.beginWriting(stream);
+  Item item = { timestamp, stream };
+  q.push_back(item);
+  readerThread.finishWriting(stream);
+}
+
+/**
+ * @brief Checks that an empty stream whose last item is not older than the
+ * head of the winner does not make the merge wait.
+ */
+void checkEmptyStreamAhead()
+{
+  reader_thread readerThread;
+  writeItem(readerThread, 0, 10);
+  writeItem(readerThread, 1, 10);
+  writeItem(readerThread, 2, 20);
+  readerThread.start();
+  //Stream 0 runs empty after 10, which still lets stream 1 hand over 10,
+  //but stream 2 waits for stream 0 and 1 to get past 10.
+  for (unsigned int i = 0;
+      readerThread.getBufferHandler().getNumItems() != 2; ++i)
+  {
+    if (i == 100)
+    {
+      std::cerr << "FAILURE!" << std::endl;
+      exit(0);
+    }
+    usleep(10000);
+  }
+  usleep(10000);
+  if (readerThread.getBufferHandler().getNumItems() != 2)
+  {
+    std::cerr << "FAILURE!" << std::endl;
+    exit(0);
+  }
+  writeItem(readerThread, 0, 20);
+  writeItem(readerThread, 1, 30);
+  for (unsigned int i = 0;
+      readerThread.getBufferHandler().getNumItems() != 4; ++i)
+  {
+    if (i == 100)
+    {
+      std::cerr << "FAILURE!" << std::endl;
+      exit(0);
+    }
+    usleep(10000);
+  }
+  readerThread.stop();
+  readerThread.join();
+}
+
+int main()
+{
+  checkEmptyStreamAhead();
+
+  g_skewReaderThread.setMaxSkew(2 * NUM_STREAMS);
+  g_readerThread.start();
+  g_skewReaderThread.start();
+  boost::thread_group writers;
+  for (unsigned int i = 0; i < NUM_STREAMS; ++i)
+  {
+    writers.create_thread(boost::bind(&writer<reader_thread>,
+          &g_readerThread, i, false));
+    writers.create_thread(boost::bind(&writer<skew_reader_thread>,
+          &g_skewReaderThread, i, true));
+  }
+
+  //The stalled stream must have caused late items since the last check.
+  boost::uint64_t numLateItems = 0;
+  for (;;)
+  {
+    sleep(2);
+    boost::uint64_t n = g_skewReaderThread.getNumLateItems();
+    if (n == numLateItems)
+    {
+      std::cerr << "FAILURE!" << std::endl;
+      exit(0);
+    }
+    numLateItems = n;
+    std::cerr << numLateItems << " late items" << std::endl;
+  }
+}
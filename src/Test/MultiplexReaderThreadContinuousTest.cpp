@@ -0,0 +1,115 @@
+#include <Rabotnik/MultiplexReaderThread.h>
+#include <Rabotnik/Channel.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <iostream>
+#include <cstdlib>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+typedef StaticQueue<unsigned int, 10> queue;
+
+class BufferHandler
+{
+  const char * m_name;
+  unsigned int m_next;
+  unsigned int m_numBuffers;
+  boost::thread::id m_threadId;
+
+  public:
+    BufferHandler(const char * name)
+      : m_name(name),
+        m_next(0),
+        m_numBuffers(0)
+    {
+    }
+
+    void initializeThread()
+    {
+      m_threadId = boost::this_thread::get_id();
+    }
+
+    void uninitializeThread()
+    {
+      if (m_threadId != boost::this_thread::get_id())
+      {
+        std::cerr << "FAILURE!" << std::endl;
+        exit(0);
+      }
+    }
+
+    void processBuffer(queue & q)
+    {
+      //Handlers are initialized and run on the multiplexing thread.
+      if (m_threadId != boost::this_thread::get_id())
+      {
+        std::cerr << "FAILURE!" << std::endl;
+        exit(0);
+      }
+      BOOST_FOREACH(unsigned int u, q)
+      {
+        if (u != m_next++)
+        {
+          std::cerr << "FAILURE!" << std::endl;
+          exit(0);
+        }
+      }
+      if (++m_numBuffers % 100000 == 0)
+      {
+        std::cerr << m_name << ": " << m_numBuffers << " buffers"
+          << std::endl;
+      }
+    }
+};
+
+typedef Channel<PushBufferQueue<queue, 3>, BufferHandler> channel;
+
+channel g_high("high");
+channel g_low("low");
+channel g_heavy("heavy");
+channel g_light("light");
+
+MultiplexReaderThread g_strictThread(MULTIPLEX_STRICT_PRIORITY);
+MultiplexReaderThread g_fairThread(MULTIPLEX_WEIGHTED_FAIR);
+
+void writer(channel * c)
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    for (unsigned int i = 0; i <= 10; ++i)
+    {
+      queue & q = c->beginWriting();
+      q.clear();
+      for (unsigned int j = 0; j < i; ++j)
+      {
+        q.push_back(d++);
+      }
+      c->finishWriting();
+    }
+  }
+}
+
+int main()
+{
+  g_strictThread.addChannel(g_low, 0);
+  g_strictThread.addChannel(g_high, 1);
+  g_fairThread.addChannel(g_heavy, 0, 3, 2);
+  g_fairThread.addChannel(g_light, 0, 1, 2);
+  g_strictThread.start();
+  g_fairThread.start();
+
+  boost::thread_group writers;
+  writers.create_thread(boost::bind(writer, &g_high));
+  writers.create_thread(boost::bind(writer, &g_low));
+  writers.create_thread(boost::bind(writer, &g_heavy));
+  writers.create_thread(boost::bind(writer, &g_light));
+  writers.join_all();
+}
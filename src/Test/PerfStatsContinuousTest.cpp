@@ -0,0 +1,202 @@
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+typedef StaticQueue<unsigned int, 10> queue;
+
+void fail()
+{
+  std::cerr << "FAILURE!" << std::endl;
+  exit(0);
+}
+
+/**
+ * @brief Counts what it handles, to compare with the perf stats.
+ */
+class BufferHandler
+{
+  unsigned int m_next;
+  boost::atomic<boost::uint64_t> m_numBuffers;
+  boost::atomic<boost::uint64_t> m_numItems;
+
+  public:
+    BufferHandler()
+      : m_next(0),
+        m_numBuffers(0),
+        m_numItems(0)
+    {
+    }
+
+    void processBuffer(queue & q)
+    {
+      BOOST_FOREACH(unsigned int u, q)
+      {
+        if (u != m_next++)
+        {
+          fail();
+        }
+      }
+      m_numItems += q.length();
+      ++m_numBuffers;
+    }
+
+    /**
+     * @brief Buffers without length() count as one item.
+     */
+    void processBuffer(unsigned int u)
+    {
+      if (u != m_next++)
+      {
+        fail();
+      }
+      ++m_numItems;
+      ++m_numBuffers;
+    }
+
+    boost::uint64_t getNumBuffers() const { return m_numBuffers; }
+    boost::uint64_t getNumItems() const { return m_numItems; }
+};
+
+/**
+ * @brief Empties each buffer, which must not change the item count.
+ */
+struct ConsumingHandler
+{
+  void processBuffer(queue & q)
+  {
+    q.clear();
+  }
+};
+
+typedef ReaderThread<PushBufferQueue<queue, 3>, BufferHandler>
+  reader_thread;
+typedef ReaderThread<PushBufferQueue<unsigned int, 3>, BufferHandler>
+  single_reader_thread;
+typedef ReaderThread<PushBufferQueue<queue, 3>, ConsumingHandler>
+  consuming_reader_thread;
+
+reader_thread g_readerThread;
+single_reader_thread g_singleReaderThread;
+consuming_reader_thread g_consumingReaderThread;
+
+void writer()
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    for (unsigned int i = 0; i <= 10; ++i)
+    {
+      queue & q = g_readerThread.beginWriting();
+      for (unsigned int j = 0; j < i; ++j)
+      {
+        q.push_back(d++);
+      }
+      g_readerThread.finishWriting();
+    }
+  }
+}
+
+void fullWriter()
+{
+  for (;;)
+  {
+    queue & q = g_consumingReaderThread.beginWriting();
+    for (unsigned int i = 0; i < queue::capacity; ++i)
+    {
+      q.push_back(i);
+    }
+    g_consumingReaderThread.finishWriting();
+  }
+}
+
+void singleWriter()
+{
+  for (unsigned int d = 0;; ++d)
+  {
+    g_singleReaderThread.beginWriting() = d;
+    g_singleReaderThread.finishWriting();
+  }
+}
+
+/**
+ * @brief Checks the stats against the handler. The stats are updated after
+ * the handler returns, so they are read first.
+ */
+template<typename _ReaderThread>
+void check(_ReaderThread & readerThread, const char * name)
+{
+  PerfStats stats = readerThread.getPerfStats();
+  const BufferHandler & handler = readerThread.getBufferHandler();
+  if (!stats.numBuffers || stats.numBuffers > handler.getNumBuffers()
+      || stats.numItems > handler.getNumItems()
+      || (stats.isAvailable && (!stats.cycles || !stats.instructions)))
+  {
+    fail();
+  }
+  std::cerr << name << ": " << stats.numBuffers << " buffers, "
+    << stats.numItems << " items";
+  if (stats.isAvailable)
+  {
+    std::cerr << ", " << double(stats.instructions) / stats.numItems
+      << " instructions/item, " << double(stats.cycles) / stats.numItems
+      << " cycles/item, " << stats.cacheMisses << " cache misses, "
+      << stats.branchMisses << " branch misses";
+  }
+  else
+  {
+    std::cerr << ", counters not available";
+  }
+  std::cerr << std::endl;
+  readerThread.resetPerfStats();
+}
+
+int main()
+{
+  g_readerThread.enablePerfCounters();
+  g_singleReaderThread.enablePerfCounters();
+  g_consumingReaderThread.enablePerfCounters();
+  g_readerThread.start();
+  g_singleReaderThread.start();
+  g_consumingReaderThread.start();
+  boost::thread w(writer);
+  boost::thread s(singleWriter);
+  boost::thread f(fullWriter);
+
+  for (;;)
+  {
+    sleep(1);
+    check(g_readerThread, "queue");
+    check(g_singleReaderThread, "single");
+
+    //Without length(), each buffer is one item. The two counts are read
+    //separately, so one buffer may be counted in only one of them.
+    PerfStats stats = g_singleReaderThread.getPerfStats();
+    if (stats.numItems + 1 < stats.numBuffers
+        || stats.numItems > stats.numBuffers + 1)
+    {
+      fail();
+    }
+
+    //Items are counted before the handler empties the buffer.
+    stats = g_consumingReaderThread.getPerfStats();
+    const boost::uint64_t n = queue::capacity;
+    if (!stats.numBuffers || stats.numItems + n < stats.numBuffers * n
+        || stats.numItems > (stats.numBuffers + 1) * n)
+    {
+      fail();
+    }
+    g_consumingReaderThread.resetPerfStats();
+  }
+}
@@ -0,0 +1,107 @@
+#include <Rabotnik/PeriodicReaderThread.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+const unsigned int MAX_BUFFERS_PER_PERIOD = 2;
+
+typedef StaticQueue<unsigned int, 10> queue;
+
+boost::atomic<boost::uint64_t> g_numBuffers(0);
+boost::atomic<boost::uint64_t> g_numIdle(0);
+
+class BufferHandler
+{
+  unsigned int m_next;
+
+  public:
+    BufferHandler()
+      : m_next(0)
+    {
+    }
+
+    void processBuffer(queue & q)
+    {
+      BOOST_FOREACH(unsigned int u, q)
+      {
+        if (u != m_next++)
+        {
+          std::cerr << "FAILURE!" << std::endl;
+          exit(0);
+        }
+      }
+      ++g_numBuffers;
+    }
+
+    void processIdle()
+    {
+      ++g_numIdle;
+    }
+};
+
+typedef PeriodicReaderThread<PushBufferQueue<queue, 8>, BufferHandler>
+  reader_thread;
+
+reader_thread g_readerThread;
+
+void writer()
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    //A burst, which takes several periods to handle, and a pause with idle
+    //periods.
+    for (unsigned int i = 0; i < 100; ++i)
+    {
+      queue & q = g_readerThread.beginWriting();
+      for (unsigned int j = 0; j < i % 11; ++j)
+      {
+        q.push_back(d++);
+      }
+      g_readerThread.finishWriting();
+    }
+    usleep(20000);
+  }
+}
+
+int main()
+{
+  g_readerThread.setPeriod(1000000);
+  g_readerThread.setMaxBuffersPerPeriod(MAX_BUFFERS_PER_PERIOD);
+  g_readerThread.start();
+  boost::thread w(writer);
+
+  boost::uint64_t numBuffers = 0;
+  boost::uint64_t numIdle = 0;
+  for (;;)
+  {
+    sleep(1);
+    //Read the buffer count first. It may still include buffers of a period
+    //not yet counted in the stats.
+    boost::uint64_t n = g_numBuffers;
+    PeriodicStats stats = g_readerThread.getStats();
+    if (n == numBuffers || g_numIdle == numIdle
+        || n > (stats.numPeriods + 1) * MAX_BUFFERS_PER_PERIOD)
+    {
+      std::cerr << "FAILURE!" << std::endl;
+      exit(0);
+    }
+    numBuffers = n;
+    numIdle = g_numIdle;
+    std::cerr << stats.numPeriods << " periods, " << numBuffers
+      << " buffers, " << numIdle << " idle, "
+      << stats.numMissedDeadlines << " missed, max jitter "
+      << stats.maxJitterNsec << " nsec" << std::endl;
+  }
+}
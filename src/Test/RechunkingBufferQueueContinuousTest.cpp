@@ -0,0 +1,102 @@
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <Rabotnik/RechunkingBufferQueue.h>
+#include <Rabotnik/StaticQueue.h>
+#include <iostream>
+#include <cstdlib>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+typedef StaticQueue<unsigned int, 10> queue;
+typedef RechunkingBufferQueue<PushBufferQueue<queue, 3>, 7> rechunking_queue;
+
+class BufferHandler
+{
+  unsigned int m_next;
+  unsigned int m_numFrames;
+  unsigned int m_numCopied;
+
+  public:
+    BufferHandler()
+      : m_next(0),
+        m_numFrames(0),
+        m_numCopied(0)
+    {
+    }
+
+    void processBuffer(rechunking_queue::read_buffer & frame)
+    {
+      if (frame.length() != 7)
+      {
+        std::cerr << "FAILURE!" << std::endl;
+        exit(0);
+      }
+      BOOST_FOREACH(unsigned int u, frame)
+      {
+        if (u != m_next++)
+        {
+          std::cerr << "FAILURE!" << std::endl;
+          exit(0);
+        }
+      }
+      m_numCopied += frame.isCopied();
+      if (++m_numFrames % 100000 == 0)
+      {
+        std::cerr << m_numFrames << " frames, " << m_numCopied << " copied"
+          << std::endl;
+      }
+    }
+};
+
+ReaderThread<rechunking_queue, BufferHandler> g_readerThread;
+
+void writeBuffer(unsigned int & d, unsigned int n)
+{
+  queue & q = g_readerThread.beginWriting();
+  for (unsigned int i = 0; i < n; ++i)
+  {
+    q.push_back(d++);
+  }
+  g_readerThread.finishWriting();
+}
+
+void writer()
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    for (unsigned int i = 0; i < 1000; ++i)
+    {
+      //Vary the buffer sizes, including empty buffers and ones shorter than
+      //a frame.
+      writeBuffer(d, rand() % 11);
+    }
+
+    //Interrupt the reader while it waits in the middle of copying a frame,
+    //and check that the frame is resumed after a restart.
+    if (d % 7 == 0)
+    {
+      writeBuffer(d, 1 + rand() % 6);
+    }
+    g_readerThread.getBufferQueue().getBufferQueue().waitForEmpty();
+    g_readerThread.interrupt();
+    g_readerThread.join();
+    g_readerThread.start();
+  }
+}
+
+int main()
+{
+  g_readerThread.start();
+  boost::thread w(writer);
+  w.join();
+  g_readerThread.stop();
+  g_readerThread.join();
+}
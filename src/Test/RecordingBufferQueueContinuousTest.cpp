@@ -0,0 +1,169 @@
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <Rabotnik/RecordingBufferQueue.h>
+#include <Rabotnik/BufferReplayer.h>
+#include <iostream>
+#include <cstdlib>
+#include <time.h>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+const char * PATH = "/tmp/rabotnik-recording-test.bin";
+const unsigned int NUM_BUFFERS = 1000;
+const unsigned int NUM_PACED_BUFFERS = 20;
+const boost::uint64_t PACED_INTERVAL_NSEC = 1000000;
+
+typedef StaticQueue<unsigned int, 10> queue;
+
+void fail()
+{
+  std::cerr << "FAILURE!" << std::endl;
+  exit(0);
+}
+
+boost::uint64_t now()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+class BufferHandler
+{
+  unsigned int m_next;
+
+  public:
+    BufferHandler()
+      : m_next(0)
+    {
+    }
+
+    void processBuffer(queue & q)
+    {
+      BOOST_FOREACH(unsigned int u, q)
+      {
+        if (u != m_next++)
+        {
+          fail();
+        }
+      }
+    }
+
+    unsigned int getNumItems() const
+    {
+      return m_next;
+    }
+};
+
+typedef ReaderThread<RecordingBufferQueue<PushBufferQueue<queue, 4> >,
+  BufferHandler> recording_thread;
+typedef ReaderThread<PushBufferQueue<queue, 4>, BufferHandler> reader_thread;
+
+/**
+ * @return Number of items recorded.
+ */
+unsigned int record(unsigned int numBuffers, bool isPaced)
+{
+  recording_thread recorder;
+  recorder.getBufferQueue().startRecording(PATH);
+  recorder.start();
+  unsigned int d = 0;
+  for (unsigned int i = 0; i < numBuffers; ++i)
+  {
+    queue & q = recorder.beginWriting();
+    for (unsigned int j = 0; j < i % 11; ++j)
+    {
+      q.push_back(d++);
+    }
+    recorder.finishWriting();
+    if (isPaced)
+    {
+      usleep(PACED_INTERVAL_NSEC / 1000);
+    }
+  }
+  recorder.getBufferQueue().getBufferQueue().waitForEmpty();
+  recorder.interrupt();
+  recorder.join();
+  recorder.getBufferQueue().stopRecording();
+  if (recorder.getBufferHandler().getNumItems() != d)
+  {
+    fail();
+  }
+  return d;
+}
+
+void replay(unsigned int numBuffers, unsigned int numItems, bool isPaced)
+{
+  reader_thread reader;
+  reader.start();
+  BufferReplayer replayer(PATH);
+  boost::uint64_t start = now();
+  if (replayer.replay(reader,
+        isPaced ? REPLAY_ORIGINAL_PACING : REPLAY_AS_FAST_AS_POSSIBLE)
+      != numBuffers)
+  {
+    fail();
+  }
+  //The first buffer is written right away.
+  if (isPaced && now() - start < (numBuffers - 1) * PACED_INTERVAL_NSEC)
+  {
+    fail();
+  }
+  reader.getBufferQueue().waitForEmpty();
+  reader.interrupt();
+  reader.join();
+  if (reader.getBufferHandler().getNumItems() != numItems)
+  {
+    fail();
+  }
+}
+
+/**
+ * @brief Checks that buffers are still read when the recording fails.
+ */
+void recordToFullDisk()
+{
+  recording_thread recorder;
+  recorder.getBufferQueue().startRecording("/dev/full");
+  recorder.start();
+  unsigned int d = 0;
+  for (unsigned int i = 0; i < NUM_BUFFERS; ++i)
+  {
+    queue & q = recorder.beginWriting();
+    q.push_back(d++);
+    recorder.finishWriting();
+  }
+  recorder.getBufferQueue().getBufferQueue().waitForEmpty();
+  recorder.interrupt();
+  recorder.join();
+  if (!recorder.getBufferQueue().isRecordingFailed()
+      || recorder.getBufferHandler().getNumItems() != d)
+  {
+    fail();
+  }
+}
+
+int main()
+{
+  recordToFullDisk();
+
+  for (unsigned int round = 1;; ++round)
+  {
+    bool isPaced = round % 10 == 0;
+    unsigned int numBuffers = isPaced ? NUM_PACED_BUFFERS : NUM_BUFFERS;
+    replay(numBuffers, record(numBuffers, isPaced), isPaced);
+    if (round % 100 == 0)
+    {
+      std::cerr << round << " rounds" << std::endl;
+    }
+  }
+}
@@ -0,0 +1,102 @@
+
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/SpillingPushBufferQueue.h>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+//Spilled buffers must be trivially copyable, so StaticQueue cannot be used.
+struct Buffer
+{
+  unsigned int length;
+  unsigned int items[10];
+};
+
+typedef SpillingPushBufferQueue<Buffer, 3> spilling_queue;
+
+class BufferHandler
+{
+  unsigned int i;
+  unsigned int m_numBuffers;
+
+  public:
+    BufferHandler()
+      : i(0),
+        m_numBuffers(0)
+    {
+    }
+
+    void processBuffer(Buffer & q, unsigned int usec) 
+    {
+      for (unsigned int j = 0; j < q.length; ++j)
+      {
+        if (q.items[j] != i)
+        {
+          std::cerr << "FAILURE!" << std::endl;
+          exit(0);
+        }
+
+        i = i ^ (i << 1);
+        ++i;
+        i &= 0xFFFFFF;
+      }
+
+      //Be slow once in a while, so that buffers get spilled.
+      if (++m_numBuffers % 1000 == 0)
+      {
+        usleep(1000);
+      }
+    }
+};
+
+typedef ReaderThread<spilling_queue, BufferHandler> reader_thread;
+
+reader_thread g_readerThread;
+
+void writer() 
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    for (int burst = 0; burst < 10000; ++burst)
+    {
+      for (int i = 7; i <= 10; ++i)
+      {
+        Buffer & q = g_readerThread.beginWriting();
+        q.length = i;
+        for (int j = 0; j < i; ++j)
+        {
+          q.items[j] = d;
+          d = d ^ (d << 1);
+          ++d;
+          d &= 0xFFFFFF;
+        }
+        g_readerThread.finishWriting();
+      }
+    }
+
+    //Let the reader catch up, so that the spill files do not fill the disk.
+    while (g_readerThread.getBufferQueue().getNumSpilledBuffers())
+    {
+      usleep(1000);
+    }
+  }
+}
+
+int main() 
+{
+  g_readerThread.getBufferQueue().enableSpill("/tmp", 64 * 1024);
+  boost::thread w(writer);
+  g_readerThread.start();
+  w.join();
+  g_readerThread.stop();
+  g_readerThread.join();
+}
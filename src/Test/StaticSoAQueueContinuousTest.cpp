@@ -0,0 +1,115 @@
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/StaticSoAQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <iostream>
+#include <cstdlib>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+typedef StaticSoAQueue<10, unsigned int, double, char> queue;
+
+void fail()
+{
+  std::cerr << "FAILURE!" << std::endl;
+  exit(0);
+}
+
+bool isAligned(const void * p)
+{
+  return reinterpret_cast<size_t>(p) % RABOTNIK_CACHE_LINE_SIZE == 0;
+}
+
+class BufferHandler
+{
+  unsigned int m_next;
+  unsigned int m_numBuffers;
+
+  public:
+    BufferHandler()
+      : m_next(0),
+        m_numBuffers(0)
+    {
+    }
+
+    void processBuffer(const queue & q)
+    {
+      StaticSoAColumn<const unsigned int> ids = q.column<0>();
+      StaticSoAColumn<const double> values = q.column<1>();
+      StaticSoAColumn<const char> tags = q.column<2>();
+      if (!isAligned(ids.data()) || !isAligned(values.data())
+          || !isAligned(tags.data()) || ids.length() != q.length())
+      {
+        fail();
+      }
+      //Loop over single columns, as a handler using the layout would.
+      double sum = 0;
+      for (size_t i = 0; i < values.length(); ++i)
+      {
+        sum += values[i];
+      }
+      for (size_t i = 0; i < q.length(); ++i)
+      {
+        unsigned int id = m_next++;
+        if (ids[i] != id || q[i].get<1>() != id * 0.5
+            || tags[i] != char('a' + id % 26))
+        {
+          fail();
+        }
+        sum -= id * 0.5;
+      }
+      if (sum != 0)
+      {
+        fail();
+      }
+      if (++m_numBuffers % 100000 == 0)
+      {
+        std::cerr << m_numBuffers << " buffers" << std::endl;
+      }
+    }
+};
+
+typedef ReaderThread<PushBufferQueue<queue, 3>, BufferHandler> reader_thread;
+
+reader_thread g_readerThread;
+
+void writer()
+{
+  unsigned int d = 0;
+  for(;;)
+  {
+    for (unsigned int i = 0; i <= 10; ++i)
+    {
+      queue & q = g_readerThread.beginWriting();
+      //Write half of the rows with push_back() and the rest with a writer.
+      for (unsigned int j = 0; j < i / 2; ++j, ++d)
+      {
+        q.push_back(d, d * 0.5, char('a' + d % 26));
+      }
+      queue::writer w = q.beginWriting();
+      for (unsigned int j = i / 2; j < i; ++j, ++d)
+      {
+        queue::row_reference row = w.push_back();
+        row.get<0>() = d;
+        row.get<1>() = d * 0.5;
+        row.get<2>() = char('a' + d % 26);
+      }
+      q.finishWriting(w);
+      g_readerThread.finishWriting();
+    }
+  }
+}
+
+int main()
+{
+  boost::thread w(writer);
+  g_readerThread.start();
+  w.join();
+  g_readerThread.stop();
+  g_readerThread.join();
+}
@@ -0,0 +1,225 @@
+#include <Rabotnik/StreamingStaticQueue.h>
+#include <iostream>
+#include <cstdlib>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+/**
+ * @brief Item with a check value, so that reading an item before it is
+ * published fails.
+ */
+struct Item
+{
+  unsigned int value;
+  unsigned int check;
+
+  Item()
+    : value(0),
+      check(0)
+  {
+  }
+
+  Item(unsigned int itemValue)
+    : value(itemValue),
+      check(~itemValue)
+  {
+  }
+};
+
+typedef StreamingStaticQueue<Item, 10000> queue;
+
+const unsigned int NUM_READERS = 3;
+
+queue g_queue;
+
+/**
+ * @brief Held shared by readers while reading, and uniquely by the writer
+ * while clearing.
+ */
+boost::shared_mutex g_clearMutex;
+boost::atomic<unsigned int> g_numClears(0);
+
+/**
+ * @brief Number of items written in all, and read by each reader.
+ */
+boost::atomic<boost::uint64_t> g_numWritten(0);
+boost::atomic<boost::uint64_t> g_numRead[NUM_READERS];
+
+void fail()
+{
+  std::cerr << "FAILURE!" << std::endl;
+  exit(0);
+}
+
+class Random
+{
+  unsigned int m_state;
+
+  public:
+    Random(unsigned int seed)
+      : m_state(seed)
+    {
+    }
+
+    unsigned int next()
+    {
+      m_state ^= m_state << 13;
+      m_state ^= m_state >> 17;
+      m_state ^= m_state << 5;
+      return m_state;
+    }
+};
+
+/**
+ * @brief Waits for the readers to have read every item, and clears the
+ * queue.
+ */
+void clear()
+{
+  for (unsigned int i = 0; i < NUM_READERS; ++i)
+  {
+    while (g_numRead[i] != g_numWritten)
+    {
+      boost::this_thread::yield();
+    }
+  }
+  boost::unique_lock<boost::shared_mutex> lock(g_clearMutex);
+  g_queue.clear();
+  ++g_numClears;
+}
+
+void writer()
+{
+  Random random(1);
+  unsigned int d = 0;
+  for (;;)
+  {
+    unsigned int n = random.next() % 10 + 1;
+    if (g_queue.length() + n > queue::capacity)
+    {
+      clear();
+    }
+    //Write the items one by one, unpublished and published together, with a
+    //writer, and constructed in place.
+    switch (random.next() % 4)
+    {
+      case 0:
+        for (unsigned int i = 0; i < n; ++i)
+        {
+          g_queue.push_back(Item(d++));
+        }
+        break;
+      case 1:
+        for (unsigned int i = 0; i < n; ++i)
+        {
+          Item & item = g_queue.push_back();
+          item.value = d;
+          item.check = ~d++;
+        }
+        g_queue.publish();
+        break;
+#ifdef RABOTNIK_HAS_VARIADIC_FORWARDING
+      case 3:
+        for (unsigned int i = 0; i < n; ++i)
+        {
+          Item & item = g_queue.emplace_back(d);
+          if (item.value != d++)
+          {
+            fail();
+          }
+        }
+        break;
+#endif
+      default:
+        {
+          queue::writer w = g_queue.beginWriting();
+          for (unsigned int i = 0; i < n; ++i)
+          {
+            w.push_back(Item(d++));
+          }
+          g_queue.finishWriting(w);
+        }
+        break;
+    }
+    g_numWritten += n;
+    //Readers catch up now and then, and resume from the middle of the
+    //queue.
+    if (random.next() % 1000 == 0)
+    {
+      boost::this_thread::sleep(boost::posix_time::microseconds(100));
+    }
+  }
+}
+
+void reader(unsigned int index)
+{
+  Random random(index + 2);
+  queue::reader r(g_queue);
+  unsigned int numClears = 0;
+  unsigned int next = 0;
+  for (;;)
+  {
+    {
+      boost::shared_lock<boost::shared_mutex> lock(g_clearMutex);
+      if (numClears != g_numClears)
+      {
+        numClears = g_numClears;
+        r.rewind();
+      }
+      r.update();
+      for (queue::const_iterator it = r.begin(); it != r.end(); ++it)
+      {
+        if (it->value != next++ || it->check != ~it->value)
+        {
+          fail();
+        }
+      }
+      g_numRead[index] += r.end() - r.begin();
+    }
+    if (random.next() % 100 == 0)
+    {
+      boost::this_thread::sleep(
+          boost::posix_time::microseconds(random.next() % 100));
+    }
+    else
+    {
+      boost::this_thread::yield();
+    }
+  }
+}
+
+int main()
+{
+  for (unsigned int i = 0; i < NUM_READERS; ++i)
+  {
+    g_numRead[i] = 0;
+  }
+  boost::thread_group threads;
+  for (unsigned int i = 0; i < NUM_READERS; ++i)
+  {
+    threads.create_thread(boost::bind(reader, i));
+  }
+  threads.create_thread(writer);
+
+  for (;;)
+  {
+    boost::uint64_t numWritten = g_numWritten;
+    boost::this_thread::sleep(boost::posix_time::seconds(2));
+    //The writer only waits for the readers to catch up before clearing.
+    if (g_numWritten == numWritten)
+    {
+      fail();
+    }
+    std::cerr << g_numWritten << " items, " << g_numClears << " clears"
+      << std::endl;
+  }
+}
@@ -0,0 +1,157 @@
+#include <Rabotnik/ReaderThread.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <Rabotnik/Trace.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <cstdlib>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+#ifndef RABOTNIK_TRACE
+#error This test must be built with RABOTNIK_TRACE defined.
+#endif
+
+using namespace Rabotnik;
+using namespace std;
+
+const unsigned int NUM_BUFFERS = 50;
+const unsigned int NUM_LEFT_BUFFERS = 2;
+//The main thread, a reader and a writer.
+const size_t MAX_RINGS = 3;
+
+typedef StaticQueue<unsigned int, 10> queue;
+
+void fail()
+{
+  std::cerr << "FAILURE!" << std::endl;
+  exit(0);
+}
+
+class BufferHandler
+{
+  unsigned int m_next;
+
+  public:
+    BufferHandler()
+      : m_next(0)
+    {
+    }
+
+    void processBuffer(queue & q)
+    {
+      BOOST_FOREACH(unsigned int u, q)
+      {
+        if (u != m_next++)
+        {
+          fail();
+        }
+      }
+    }
+};
+
+typedef ReaderThread<PushBufferQueue<queue, 3>, BufferHandler> reader_thread;
+
+void writeBuffers(reader_thread * readerThread, unsigned int first,
+    unsigned int numBuffers)
+{
+  for (unsigned int i = 0; i < numBuffers; ++i)
+  {
+    queue & q = readerThread->beginWriting();
+    q.clear();
+    queue::writer w = q.beginWriting();
+    for (unsigned int j = 0; j < 5; ++j)
+    {
+      w.push_back(first++);
+    }
+    q.finishWriting(w);
+    readerThread->finishWriting();
+  }
+}
+
+/**
+ * @brief Checks that the begin and end events of each thread match.
+ */
+void checkDump()
+{
+  std::ostringstream out;
+  Trace::dump(out);
+  if (out.flags() & std::ios_base::fixed)
+  {
+    fail();
+  }
+
+  std::map<std::string, int> depths;
+  std::istringstream in(out.str());
+  std::string line;
+  while (std::getline(in, line))
+  {
+    size_t ph = line.find("\"ph\":\"");
+    size_t tid = line.find("\"tid\":");
+    if (ph == std::string::npos || tid == std::string::npos)
+    {
+      continue;
+    }
+    int & depth = depths[line.substr(tid + 6, line.find_first_of(",}", tid)
+        - tid - 6)];
+    char phase = line[ph + 6];
+    if (phase == 'B')
+    {
+      ++depth;
+    }
+    else if (phase == 'E' && --depth < 0)
+    {
+      fail();
+    }
+  }
+  for (std::map<std::string, int>::const_iterator it = depths.begin();
+      it != depths.end(); ++it)
+  {
+    if (it->second != 0)
+    {
+      fail();
+    }
+  }
+}
+
+int main()
+{
+  for (unsigned int round = 1;; ++round)
+  {
+    {
+      reader_thread readerThread;
+      readerThread.start();
+      boost::thread w(boost::bind(&writeBuffers, &readerThread, 0,
+            NUM_BUFFERS));
+      w.join();
+      readerThread.getBufferQueue().waitForEmpty();
+      //Interrupts the reader while it is parked.
+      readerThread.interrupt();
+      readerThread.join();
+      //Leaves full buffers for the destructor of the queue.
+      boost::thread l(boost::bind(&writeBuffers, &readerThread, 0,
+            NUM_LEFT_BUFFERS));
+      l.join();
+    }
+    checkDump();
+
+    {
+      Trace::Internal::Registry & registry = Trace::Internal::getRegistry();
+      boost::unique_lock<boost::mutex> lock(registry.mutex);
+      if (registry.rings.size() > MAX_RINGS)
+      {
+        fail();
+      }
+    }
+    if (round % 1000 == 0)
+    {
+      std::cerr << round << " rounds" << std::endl;
+    }
+  }
+}
@@ -0,0 +1,147 @@
+
+#include <Rabotnik/WorkStealingExecutor.h>
+#include <Rabotnik/StaticQueue.h>
+#include <Rabotnik/PushBufferQueue.h>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+//Hack to get around getpagesize() working on iOS SDK where it is deprecated
+//and removed when _POSIX_SOURCE is defined. It is required by thread.hpp.
+extern "C" { int getpagesize(); }
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+#include <boost/atomic.hpp>
+
+using namespace Rabotnik;
+using namespace std;
+
+const unsigned int NUM_CHANNELS = 64;
+const unsigned int NUM_WRITERS = 4;
+
+typedef StaticQueue<unsigned int, 10> queue;
+
+class BufferHandler
+{
+  unsigned int i;
+  boost::atomic<bool> m_isProcessing;
+
+  public:
+    BufferHandler()
+      : i(0),
+        m_isProcessing(false)
+    {
+    }
+
+    void processBuffer(queue & q, unsigned int usec) 
+    {
+      if (m_isProcessing.exchange(true))
+      {
+        std::cerr << "CONCURRENT PROCESSING!" << std::endl;
+        exit(0);
+      }
+
+      BOOST_FOREACH(unsigned int u, q)
+      {
+        if (u != i)
+        {
+          std::cerr << "FAILURE!" << std::endl;
+          exit(0);
+        }
+
+        i = i ^ (i << 1);
+        ++i;
+        i &= 0xFFFFFF;
+      }
+
+      m_isProcessing = false;
+    }
+};
+
+typedef Channel<PushBufferQueue<queue, 3>, BufferHandler> channel;
+
+/**
+ * @brief Handler with thread hooks, which the executor must reject.
+ */
+struct ThreadHookHandler
+{
+  void initializeThread() {}
+  void processBuffer(queue & /*q*/) {}
+};
+
+channel g_channels[NUM_CHANNELS];
+
+WorkStealingExecutor g_executor;
+
+/**
+ * @brief Writes bursts to the channels of one writer, ie. channels with
+ * index % NUM_WRITERS == writerIndex.
+ */
+void writer(unsigned int writerIndex) 
+{
+  unsigned int d[NUM_CHANNELS] = { 0 };
+  unsigned int r = writerIndex + 1;
+  for(;;)
+  {
+    r = r ^ (r << 1);
+    ++r;
+    r &= 0xFFFFFF;
+    unsigned int c = (r % (NUM_CHANNELS / NUM_WRITERS)) * NUM_WRITERS 
+      + writerIndex;
+
+    for (unsigned int burst = 0; burst < r % 16; ++burst)
+    {
+      for (int i = 7; i <= 10; ++i)
+      {
+        queue & q = g_channels[c].beginWriting();
+        queue::writer w = q.beginWriting();
+        for (int j = 0; j < i; ++j)
+        {
+          w.push_back(d[c]);
+          d[c] = d[c] ^ (d[c] << 1);
+          ++d[c];
+          d[c] &= 0xFFFFFF;
+        }
+        q.finishWriting(w);
+        g_channels[c].finishWriting();
+      }
+    }
+  }
+}
+
+int main() 
+{
+  {
+    Channel<PushBufferQueue<queue, 3>, ThreadHookHandler> hookChannel;
+    bool isRejected = false;
+    try
+    {
+      g_executor.addChannel(hookChannel);
+    }
+    catch (const Exception &)
+    {
+      isRejected = true;
+    }
+    if (!isRejected)
+    {
+      std::cerr << "FAILURE!" << std::endl;
+      exit(0);
+    }
+  }
+
+  for (unsigned int i = 0; i < NUM_CHANNELS; ++i)
+  {
+    g_executor.addChannel(g_channels[i]);
+  }
+  g_executor.setBudget(4);
+  g_executor.start();
+
+  boost::thread_group writers;
+  for (unsigned int i = 0; i < NUM_WRITERS; ++i)
+  {
+    writers.create_thread(boost::bind(writer, i));
+  }
+  writers.join_all();
+  g_executor.stop();
+  g_executor.join();
+}